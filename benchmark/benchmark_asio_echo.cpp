@@ -94,10 +94,11 @@ void StartPrintEchoCount()
 
 	GO
 	{
+		auto ticker = interval(1s);
 		for (;;)
 		{
 			g_echo_count.exchange(0, std::memory_order_release);
-			co_await 1s;
+			co_await ticker;
 			std::cout << g_echo_count.load(std::memory_order_acquire) << std::endl;
 		}
 	};
@@ -22,9 +22,11 @@
 #include <atomic>
 #include <chrono>
 #include <array>
+#include <limits>
 #include <vector>
 #include <deque>
 #include <mutex>
+#include <condition_variable>
 #include <map>
 #include <list>
 #include <any>
@@ -34,6 +36,8 @@
 #include <thread>
 #include <cassert>
 #include <utility>
+#include <memory_resource>
+#include <algorithm>
 
 #if __cpp_impl_coroutine
 #include <coroutine>
@@ -85,6 +89,9 @@ extern "C" void _coro_resume_block();
 #include "src/type_traits.inl"
 #include "src/type_concept.inl"
 #include "src/spinlock.h"
+#include "src/intrusive_mpsc_queue.h"
+#include "src/pool_allocator.h"
+#include "src/frame_allocator.h"
 #include "src/state.h"
 #include "src/future.h"
 #include "src/promise.h"
@@ -94,19 +101,23 @@ extern "C" void _coro_resume_block();
 #include "src/rf_task.h"
 #include "src/timer.h"
 #include "src/scheduler.h"
+#include "src/scheduler_pool.h"
 
 #include "src/promise.inl"
 #include "src/state.inl"
+#include "src/lazy.h"
 
 #include "src/switch_scheduler.h"
 #include "src/current_scheduler.h"
 
 #include "src/yield.h"
 #include "src/sleep.h"
+#include "src/ticker.h"
 #include "src/when.h"
 
 #include "src/_awaker.h"
 #include "src/ring_queue.h"
+#include "src/ring_queue_lockfree.h"
 #include "src/intrusive_link_queue.h"
 #include "src/channel.h"
 #include "src/event.h"
@@ -2,3 +2,4 @@
 
 #include "channel_v2.h"
 #include "channel_v2.inl"
+#include "channel_select.h"
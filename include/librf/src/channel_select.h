@@ -0,0 +1,306 @@
+﻿//同时等待多个channel_t的读写操作，只有最先完成的一个生效
+//
+#pragma once
+
+namespace librf
+{
+#ifndef DOXYGEN_SKIP_PROPERTY
+	namespace detail
+	{
+		/*
+		select()挂起时，每个分支在各自channel的等待队列里放一个state，它们共享state_select_t::_winner。
+		channel从等待队列里取出分支的state后，先通过CAS将_winner从-1改为分支的下标，成功了才交换数据并唤醒协程；
+		失败说明其他分支已经胜出，channel跳过这个state，继续找下一个等待者。超时也是以同样的方式竞争_winner。
+		协程恢复后，在各个channel的锁内，将没有胜出的分支从等待队列里移除。
+		*/
+		struct state_select_t : public state_base_t
+		{
+			state_select_t() noexcept
+			{
+				disable_confined();
+			}
+
+			virtual void resume() override
+			{
+				coroutine_handle<> handler = _coro;
+				if (handler)
+				{
+					_coro = nullptr;
+					_scheduler->del_final(this);
+					handler.resume();
+				}
+			}
+
+			virtual bool has_handler() const  noexcept override
+			{
+				return (bool)_coro;
+			}
+
+			template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
+			void on_await_suspend(coroutine_handle<_PromiseT> handler) noexcept
+			{
+				_PromiseT& promise = handler.promise();
+				auto* parent_state = promise.get_state();
+				scheduler_t* sch = parent_state->get_scheduler();
+
+				this->_scheduler = sch;
+				this->_priority = parent_state->get_priority();
+				this->_coro = handler;
+			}
+
+			void add_timeout_timer(timer_manager::time_point_type tp, intptr_t index)
+			{
+				//定时器持有一个引用，在回调里释放
+				this->lock();
+				_timeout_index = index;
+				_timer.tp = tp;
+				_timer.cb = [this](bool canceld)
+					{
+						if (!canceld)
+							this->on_timeout();
+						this->unlock();
+					};
+				this->_scheduler->timer()->add(&_timer);
+			}
+
+			void stop_timeout_timer() noexcept
+			{
+				if (_timer.is_pending())
+					this->_scheduler->timer()->stop(&_timer);
+			}
+
+			//协程没有等到结果就被销毁了
+			void on_cancel() noexcept
+			{
+				stop_timeout_timer();
+				this->_coro = nullptr;
+			}
+
+			void on_timeout()
+			{
+				intptr_t expected = -1;
+				if (_winner.compare_exchange_strong(expected, _timeout_index, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					if (this->_coro)
+						this->_scheduler->add_generator(this);
+				}
+			}
+
+			std::atomic<intptr_t> _winner{ -1 };
+		private:
+			timer_manager::timer_node _timer;
+			intptr_t _timeout_index = -1;
+		};
+
+		struct select_timeout_t
+		{
+			timer_manager::time_point_type _tp;
+
+			bool select_try_nolock() const noexcept
+			{
+				return _tp <= timer_manager::clock_type::now();
+			}
+		};
+
+		//各个channel的锁类型可能不同，故抹去类型后统一按地址排序加锁
+		struct select_lock_t
+		{
+			void* _lock;
+			void (*_lock_fn)(void*);
+			void (*_unlock_fn)(void*);
+
+			template<class _Lock>
+			static select_lock_t make(_Lock& lk) noexcept
+			{
+				return { &lk, [](void* p) { static_cast<_Lock*>(p)->lock(); }, [](void* p) { static_cast<_Lock*>(p)->unlock(); } };
+			}
+		};
+
+		//按地址顺序加锁，避免与其他select()死锁。同一个channel出现多次时，只加锁一次
+		struct select_lock_guard
+		{
+			select_lock_guard(select_lock_t* locks, size_t count)
+				: _locks(locks)
+			{
+				std::sort(locks, locks + count, [](const select_lock_t& a, const select_lock_t& b) { return std::less<void*>{}(a._lock, b._lock); });
+				_count = static_cast<size_t>(std::unique(locks, locks + count, [](const select_lock_t& a, const select_lock_t& b) { return a._lock == b._lock; }) - locks);
+
+				for (size_t i = 0; i < _count; ++i)
+					_locks[i]._lock_fn(_locks[i]._lock);
+			}
+			~select_lock_guard()
+			{
+				for (size_t i = _count; i > 0; --i)
+					_locks[i - 1]._unlock_fn(_locks[i - 1]._lock);
+			}
+
+			select_lock_guard(const select_lock_guard&) = delete;
+			select_lock_guard& operator = (const select_lock_guard&) = delete;
+		private:
+			select_lock_t* _locks;
+			size_t _count;
+		};
+
+		template<class _Ty>
+		constexpr bool is_select_timeout_v = std::is_same_v<std::remove_cvref_t<_Ty>, select_timeout_t>;
+
+		template<class _Ty>
+		concept _SelectBranchT = is_select_timeout_v<_Ty> || requires(_Ty&& v)
+		{
+			v.select_lock();
+			{ v.select_try_nolock() } -> std::same_as<bool>;
+			v.select_cancel();
+			{ v.select_result() } -> std::same_as<any_t>;
+		};
+
+		template<class... _Branch>
+		struct [[nodiscard]] select_awaiter
+		{
+			static constexpr size_t branch_count = sizeof...(_Branch);
+			static_assert((0 + ... + (is_select_timeout_v<_Branch> ? 1 : 0)) <= 1, "select() supports at most one timeout()");
+
+			select_awaiter(_Branch&&... branches)
+				: _branches(std::move(branches)...)
+			{
+			}
+			~select_awaiter()
+			{
+				//没有co_await，或者协程在挂起期间被销毁了
+				if (_state != nullptr)
+					_state->on_cancel();
+				cancel_branches_();
+			}
+
+			select_awaiter(select_awaiter&&) = default;
+			select_awaiter(const select_awaiter&) = delete;
+			select_awaiter& operator = (const select_awaiter&) = delete;
+
+			bool await_ready() const noexcept
+			{
+				return branch_count == 0;
+			}
+
+			template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
+			bool await_suspend(coroutine_handle<_PromiseT> handler)
+			{
+				std::array<select_lock_t, branch_count> locks;
+				size_t count = 0;
+				for_each_([&](auto& branch, intptr_t)
+				{
+					if constexpr (!is_select_timeout_v<decltype(branch)>)
+						locks[count++] = select_lock_t::make(branch.select_lock());
+				});
+				select_lock_guard lock_(locks.data(), count);
+
+				//持有所有channel的锁，依次尝试每个分支，第一个能立即完成的分支胜出
+				if (try_branches_(std::index_sequence_for<_Branch...>{}))
+					return false;
+
+				//都不能立即完成，则在每个channel上等待。解锁之前，其他线程不能让任何一个分支胜出
+				_state = new state_select_t();
+				_state->on_await_suspend(handler);
+				for_each_([&](auto& branch, intptr_t index)
+				{
+					if constexpr (is_select_timeout_v<decltype(branch)>)
+						_state->add_timeout_timer(branch._tp, index);
+					else
+						branch.select_wait_nolock(handler, &_state->_winner, index);
+				});
+
+				return true;
+			}
+
+			when_any_pair await_resume()
+			{
+				if (_state != nullptr)
+				{
+					_index = _state->_winner.load(std::memory_order_acquire);
+					_state->stop_timeout_timer();
+				}
+				cancel_branches_();
+
+				when_any_pair result{ _index, any_t{} };
+				for_each_([&](auto& branch, intptr_t index)
+				{
+					if constexpr (!is_select_timeout_v<decltype(branch)>)
+					{
+						if (index == _index)
+							result.second = branch.select_result();
+					}
+				});
+				return result;
+			}
+		private:
+			template<class _Fn>
+			void for_each_(_Fn&& fn)
+			{
+				for_each_impl_(fn, std::index_sequence_for<_Branch...>{});
+			}
+			template<class _Fn, size_t... _Idx>
+			void for_each_impl_(_Fn& fn, std::index_sequence<_Idx...>)
+			{
+				(fn(std::get<_Idx>(_branches), static_cast<intptr_t>(_Idx)), ...);
+			}
+
+			template<size_t... _Idx>
+			bool try_branches_(std::index_sequence<_Idx...>)
+			{
+				return (... || try_branch_<_Idx>());
+			}
+			template<size_t _Idx>
+			bool try_branch_()
+			{
+				if (std::get<_Idx>(_branches).select_try_nolock())
+				{
+					_index = static_cast<intptr_t>(_Idx);
+					return true;
+				}
+				return false;
+			}
+
+			void cancel_branches_()
+			{
+				for_each_([](auto& branch, intptr_t)
+				{
+					if constexpr (!is_select_timeout_v<decltype(branch)>)
+						branch.select_cancel();
+				});
+			}
+
+			std::tuple<_Branch...> _branches;
+			counted_ptr<state_select_t> _state;		//都不能立即完成时才创建
+			intptr_t _index = -1;
+		};
+	}
+#endif	//DOXYGEN_SKIP_PROPERTY
+
+	/**
+	 * @brief 用于select()的超时分支。
+	 * @details 到期时，如果select()的其他分支都没有完成，则超时分支胜出。\n
+	 * 时长不大于0时，表示其他分支都不能立即完成，则立即返回，不挂起协程。
+	 * @param dt 从现在开始的超时时长。
+	 */
+	template<class _Rep, class _Period>
+	inline detail::select_timeout_t timeout(const std::chrono::duration<_Rep, _Period>& dt)
+	{
+		return { timer_manager::clock_type::now() + std::chrono::duration_cast<timer_manager::duration_type>(dt) };
+	}
+
+	/**
+	 * @brief 在协程中同时等待多个channel_t的读写操作，只有最先完成的一个操作生效。
+	 * @details 分支是channel_t::read()，channel_t::write()或者channel_t::operator<<()返回的临时对象，以及最多一个timeout()。\n
+	 * 先在所有channel的锁内，按参数顺序尝试每个分支，第一个能立即完成的分支胜出，不挂起协程；
+	 * 否则在每个channel的等待队列里放一个等待者。任一分支完成时，其他分支自动失效，不会读走或者写入数据。
+	 * 不需要为每个分支创建协程。\n
+	 * 只支持channel_mode::mpmc模式的channel_t。
+	 * @param branches... 所有的分支。
+	 * @retval [co_await] std::pair<intptr_t, std::any>。第一个值指示哪个分支胜出了，第二个值是读分支读到的数据；写分支和超时分支为空。
+	 * 读到的数据需要能够存入std::any，即需要支持拷贝构造。
+	 */
+	template<class... _Branch>
+	requires(detail::_SelectBranchT<_Branch> && ...)
+	inline auto select(_Branch&&... branches) -> detail::select_awaiter<std::remove_cvref_t<_Branch>...>
+	{
+		return { std::forward<_Branch>(branches)... };
+	}
+}
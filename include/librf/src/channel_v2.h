@@ -7,10 +7,22 @@ namespace detail
 {
 	template<class _Ty, bool _Optional, bool _OptimizationThread>
 	struct channel_impl_v2;
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	struct channel_impl_lockfree;
 }	//namespace detail
 
 #endif	//DOXYGEN_SKIP_PROPERTY
 
+	/**
+	 * @brief channel_t的读写者数量模式。
+	 */
+	enum struct channel_mode : uint8_t
+	{
+		mpmc,			///< 任意数量的读写者。数据队列由锁保护
+		mpsc,			///< 多个写者，同一时刻只有一个读者。缓存的数据通过无锁环形队列传递
+		spsc,			///< 同一时刻只有一个写者，一个读者。缓存的数据通过无锁环形队列传递
+	};
+
 	/**
 	 * @brief 可传递数据的模板信号量。
 	 * @remarks 不支持数据类型为void的特例化。
@@ -18,8 +30,11 @@ namespace detail
 	 * @param _Optional 内部是否采用std::optional<>来存数据。\n
 	 * 默认不是POD类型则采用std::optional<>。如果channel缓存的元素不能凭空产生，或者产生代价较大，则推荐将此参数设置为true，从而减小不必要的开销。
 	 * @param _OptimizationThread 针对多线程优化。目前此算法提升效率不稳定，需要自行根据实际情况决定。
+	 * @param _Mode 读写者数量模式。\n
+	 * mpsc/spsc模式下，缓存未满(或者非空)时，读写只操作无锁环形队列，仅在需要挂起或者唤醒等待的协程时才加锁。
+	 * 此时缓存的数量必须大于0，否则构造时抛channel_exception(error_code::zero_capacity)，且_OptimizationThread不起作用。调用者需要保证读者(以及spsc模式下的写者)同一时刻只有一个。
 	 */
-	template<class _Ty = bool, bool _Optional = !std::is_trivial_v<_Ty>, bool _OptimizationThread = false>
+	template<class _Ty = bool, bool _Optional = !std::is_trivial_v<_Ty>, bool _OptimizationThread = false, channel_mode _Mode = channel_mode::mpmc>
 	struct channel_t
 	{
 		static_assert((std::is_copy_constructible_v<_Ty>&& std::is_copy_assignable_v<_Ty>) ||
@@ -51,7 +66,7 @@ namespace detail
 		 * @details 如果没有写入数据，则会阻塞协程。
 		 * @remarks 无缓冲的时候，先读后写，不再抛channel_exception异常。这是跟channel_v1的区别。\n
 		 * 在非协程中也可以使用。如果不能立即读取成功，则会阻塞线程。\n
-		 * 但如此用法并不能获得读取的结果，仅仅用作同步手段。
+		 * 但如此用法并不能获得读取的结果，仅仅用作同步手段。非协程中请使用read_sync()。
 		 * @return [co_await] value_type
 		 */
 		read_awaiter read() const noexcept;
@@ -67,7 +82,7 @@ namespace detail
 		/**
 		 * @brief 在协程中向channel_t里写入一个数据。
 		 * @details 在没有读操作等待时，且数据缓冲区满的情况下，则会阻塞协程。
-		 * @remarks 在非协程中也可以使用。如果不能立即写入成功，则会阻塞线程。
+		 * @remarks 在非协程中也可以使用。如果不能立即写入成功，则会阻塞线程。等同于write_sync()。
 		 * @param val 写入的数据。必须是可以成功构造_Ty(val)的类型。
 		 * @return [co_await] void
 		 */
@@ -75,6 +90,64 @@ namespace detail
 		requires(std::is_constructible_v<_Ty, U&&>)
 		write_awaiter write(U&& val) const noexcept(std::is_nothrow_move_constructible_v<U>);
 
+		/**
+		 * @brief 在协程中从channel_t里批量读取数据。
+		 * @details 没有数据可读时，阻塞协程直到读到第一个数据。此后，在一次加锁(无锁模式下不加锁)内读出所有已经可读的数据，最多max个，
+		 * 并一次性唤醒因此能够写入的写协程。不会为了凑满max个而继续等待。
+		 * @param out 输出迭代器，读到的数据依次写入。
+		 * @param max 最多读取的数量。
+		 * @return [co_await] size_t 实际读取的数量。max大于0时，至少为1。
+		 */
+		template<class _OutIt>
+		lazy_t<size_t> read_n(_OutIt out, size_t max) const;
+
+		/**
+		 * @brief 在协程中向channel_t里批量写入[first, last)之间的数据。
+		 * @details 在一次加锁(无锁模式下不加锁)内写入尽可能多的数据，并一次性唤醒等待中的读协程。
+		 * 缓冲区满了之后，阻塞协程直到可以继续写入，如此往复，直到全部写入。\n
+		 * 数据通过*first构造或者赋值，如需移动，请使用std::make_move_iterator()。
+		 * @return [co_await] void
+		 */
+		template<class _InIt>
+		lazy_t<> write_range(_InIt first, _InIt last) const;
+
+		/**
+		 * @brief 尝试从channel_t里读取一个数据。此操作无论成功与否都会立即返回。
+		 * @details 不分配等待用的state，协程和非协程中都可以使用。
+		 * @param val 读取成功时，存放读到的数据。
+		 * @return 是否读取成功。
+		 */
+		bool try_read(_Ty& val) const;
+
+		/**
+		 * @brief 尝试向channel_t里写入一个数据。此操作无论成功与否都会立即返回。
+		 * @details 不分配等待用的state，协程和非协程中都可以使用。\n
+		 * 写入失败时，如果val是左值，或者是value_type的右值，则val保持不变。
+		 * @param val 写入的数据。必须是可以成功构造_Ty(val)的类型。
+		 * @return 是否写入成功。
+		 */
+		template<class U>
+		requires(std::is_constructible_v<_Ty, U&&>)
+		bool try_write(U&& val) const;
+
+		/**
+		 * @brief 在非协程中从channel_t里读取一个数据。
+		 * @details 如果不能立即读取成功，则挂起当前线程，直到有数据写入后被唤醒。等待期间不占用CPU。
+		 * @attention 不能在协程中使用，否则会阻塞调度器所在的线程。
+		 * @return 读到的数据。
+		 */
+		_Ty read_sync() const;
+
+		/**
+		 * @brief 在非协程中向channel_t里写入一个数据。
+		 * @details 如果不能立即写入成功，则挂起当前线程，直到数据被读者取走或者放入缓存后被唤醒。等待期间不占用CPU。
+		 * @attention 不能在协程中使用，否则会阻塞调度器所在的线程。
+		 * @param val 写入的数据。必须是可以成功构造_Ty(val)的类型。
+		 */
+		template<class U>
+		requires(std::is_constructible_v<_Ty, U&&>)
+		void write_sync(U&& val) const;
+
 
 		/**
 			* @brief 构造一个无效的信号量。
@@ -92,9 +165,12 @@ namespace detail
 
 		static constexpr bool use_optional = _Optional;
 		static constexpr bool optimization_for_multithreading = _OptimizationThread;
+		static constexpr channel_mode mode = _Mode;
 
 		using optional_type = std::conditional_t<use_optional, std::optional<value_type>, value_type>;
-		using channel_type = detail::channel_impl_v2<value_type, use_optional, optimization_for_multithreading>;
+		using channel_type = std::conditional_t<mode == channel_mode::mpmc,
+			detail::channel_impl_v2<value_type, use_optional, optimization_for_multithreading>,
+			detail::channel_impl_lockfree<value_type, use_optional, mode == channel_mode::mpsc>>;
 		using lock_type = typename channel_type::lock_type;
 
 		channel_t(const channel_t&) = default;
@@ -103,18 +179,42 @@ namespace detail
 		channel_t& operator = (channel_t&&) = default;
 	private:
 		std::shared_ptr<channel_type> _chan;
+
+		//协程持有channel的引用，不依赖channel_t对象的生存期
+		template<class _OutIt>
+		static lazy_t<size_t> read_n_(std::shared_ptr<channel_type> ch, _OutIt out, size_t max);
+		template<class _InIt>
+		static lazy_t<> write_range_(std::shared_ptr<channel_type> ch, _InIt first, _InIt last);
+
+		//在非协程里读写，挂起当前线程直到成功
+		static void read_sync_(const std::shared_ptr<channel_type>& ch, optional_type& val);
+		static void write_sync_(const std::shared_ptr<channel_type>& ch, value_type& val);
 #endif	//DOXYGEN_SKIP_PROPERTY
 	};
 
 
 #ifndef DOXYGEN_SKIP_PROPERTY
 	//不支持channel_t<void>
-	template<bool _Option, bool _OptimizationThread>
-	struct channel_t<void, _Option, _OptimizationThread>
+	template<bool _Option, bool _OptimizationThread, channel_mode _Mode>
+	struct channel_t<void, _Option, _OptimizationThread, _Mode>
 	{
 	};
 #endif	//DOXYGEN_SKIP_PROPERTY
 
+	/**
+	 * @brief 多个写者，单个读者的channel_t。
+	 * @see channel_mode::mpsc
+	 */
+	template<class _Ty, bool _Optional = !std::is_trivial_v<_Ty>>
+	using mpsc_channel_t = channel_t<_Ty, _Optional, false, channel_mode::mpsc>;
+
+	/**
+	 * @brief 单个写者，单个读者的channel_t。
+	 * @see channel_mode::spsc
+	 */
+	template<class _Ty, bool _Optional = !std::is_trivial_v<_Ty>>
+	using spsc_channel_t = channel_t<_Ty, _Optional, false, channel_mode::spsc>;
+
 	/**
 	 * @brief 利用channel_t重定义的信号量。
 	 */
@@ -14,6 +14,7 @@ namespace detail
 			: _channel(std::move(ch))
 			, _value(std::addressof(val))
 		{
+			disable_confined();
 		}
 
 		virtual void resume() override
@@ -34,9 +35,15 @@ namespace detail
 
 		void on_notify()
 		{
-			assert(this->_scheduler != nullptr);
+			if (this->_scheduler == nullptr)
+			{
+				//非协程里的同步读写。唤醒者在channel的锁内通知，等待的线程取得锁之后才会销毁本state
+				_signaled.store(true, std::memory_order_release);
+				_signaled.notify_one();
+				return;
+			}
 			if (this->_coro)
-				this->_scheduler->add_generator(this);
+				this->_scheduler->add_run_next(this);
 		}
 
 		void on_cancel() noexcept
@@ -44,6 +51,32 @@ namespace detail
 			this->_coro = nullptr;
 		}
 
+		//非协程里的同步读写，没有协程句柄，也没有调度器。阻塞当前线程，直到on_notify()被调用
+		void wait_signal() noexcept
+		{
+			_signaled.wait(false, std::memory_order_acquire);
+		}
+
+		//作为select()的一个分支等待时，记录select的胜出者下标，以及本分支的下标
+		void set_select(std::atomic<intptr_t>* winner, intptr_t index) noexcept
+		{
+			_select = winner;
+			_index = index;
+		}
+
+		//channel从等待队列里取出本state后，在交换数据之前调用。
+		//select()的其他分支已经胜出时，返回false，channel应当跳过本state。
+		//无论成功与否，此后本state都不再位于等待队列里，故清除_select
+		bool on_claim() noexcept
+		{
+			std::atomic<intptr_t>* winner = std::exchange(_select, nullptr);
+			if (winner == nullptr)
+				return true;
+
+			intptr_t expected = -1;
+			return winner->compare_exchange_strong(expected, _index, std::memory_order_acq_rel, std::memory_order_acquire);
+		}
+
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
 		void on_await_suspend(coroutine_handle<_PromiseT> handler) noexcept
 		{
@@ -52,10 +85,27 @@ namespace detail
 			scheduler_t* sch = parent_state->get_scheduler();
 
 			this->_scheduler = sch;
+			this->_priority = parent_state->get_priority();
 			this->_coro = handler;
 		}
 
+		//从线程缓存内存池分配。挂起的读写不断地分配和释放同样大小的state，稳定后不再向系统申请内存
+		static state_channel_t* _Alloc_state(std::shared_ptr<_Chty> ch, value_type& val)
+		{
+			_Alloc_char _Al;
+			char* _Ptr = _Al.allocate(_Align_size<state_channel_t>());
+			return new(_Ptr) state_channel_t(std::move(ch), val);
+		}
+
 		friend _Chty;
+	private:
+		virtual void destroy_deallocate() override
+		{
+			this->~state_channel_t();
+
+			_Alloc_char _Al;
+			_Al.deallocate(reinterpret_cast<char*>(this), _Align_size<state_channel_t>());
+		}
 	protected:
 		//co_await产生的临时awaitor会引用state，管理state的生命周期
 		//state再引用channel
@@ -63,6 +113,9 @@ namespace detail
 		std::shared_ptr<_Chty> _channel;
 	protected:
 		value_type* _value;
+		std::atomic<intptr_t>* _select = nullptr;	//不为nullptr表示本state是select()的一个分支，且仍然在等待队列里
+		intptr_t _index = 0;
+		std::atomic<bool> _signaled{ false };
 	};
 
 
@@ -84,10 +137,21 @@ namespace detail
 		bool try_read(optional_type& val);
 		bool try_read_nolock(optional_type& val);
 		void add_read_list_nolock(state_read_t* state);
+		void remove_read_list_nolock(state_read_t* state);
+		template<class _Fn>
+		bool try_read_or_wait(optional_type& val, _Fn&& make_state);
 
 		bool try_write(value_type& val);
 		bool try_write_nolock(value_type& val);
 		void add_write_list_nolock(state_write_t* state);
+		void remove_write_list_nolock(state_write_t* state);
+		template<class _Fn>
+		bool try_write_or_wait(value_type& val, _Fn&& make_state);
+
+		template<class _OutIt>
+		size_t try_read_n(_OutIt& out, size_t max);
+		template<class _InIt>
+		_InIt try_write_range(_InIt first, _InIt last);
 
 		size_t capacity() const noexcept
 		{
@@ -176,6 +240,34 @@ namespace detail
 		_read_awakes.push_back(state);
 	}
 
+	//select()结束后，移除没有胜出的分支。已经被channel取出的分支，不在等待队列里
+	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	inline void channel_impl_v2<_Ty, _Optional, _OptimizationThread>::remove_read_list_nolock(state_read_t* state)
+	{
+		assert(state != nullptr);
+		if (state->_select != nullptr)
+		{
+			state->_select = nullptr;
+			if constexpr (USE_LINK_QUEUE)
+				_read_awakes.erase(state);
+			else
+				_read_awakes.remove(state);
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	template<class _Fn>
+	bool channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_read_or_wait(optional_type& val, _Fn&& make_state)
+	{
+		scoped_lock<lock_type> lock_(this->_lock);
+
+		if (try_read_nolock(val))
+			return true;
+
+		add_read_list_nolock(make_state());
+		return false;
+	}
+
 	template<class _Ty, bool _Optional, bool _OptimizationThread>
 	inline bool channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_write(value_type& val)
 	{
@@ -216,40 +308,123 @@ namespace detail
 	}
 
 	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	auto channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_pop_reader_()->state_read_t*
+	inline void channel_impl_v2<_Ty, _Optional, _OptimizationThread>::remove_write_list_nolock(state_write_t* state)
 	{
-		if constexpr (USE_LINK_QUEUE)
+		assert(state != nullptr);
+		if (state->_select != nullptr)
 		{
-			return _read_awakes.try_pop();
+			state->_select = nullptr;
+			if constexpr (USE_LINK_QUEUE)
+				_write_awakes.erase(state);
+			else
+				_write_awakes.remove(state);
 		}
-		else
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	template<class _Fn>
+	bool channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_write_or_wait(value_type& val, _Fn&& make_state)
+	{
+		scoped_lock<lock_type> lock_(this->_lock);
+
+		if (try_write_nolock(val))
+			return true;
+
+		add_write_list_nolock(make_state());
+		return false;
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	template<class _OutIt>
+	size_t channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_read_n(_OutIt& out, size_t max)
+	{
+		scoped_lock<lock_type> lock_(this->_lock);
+
+		size_t count = 0;
+		for (optional_type val; count < max && try_read_nolock(val); ++count)
 		{
-			if (!_read_awakes.empty())
+			if constexpr (_Optional)
+				*out = std::move(val).value();
+			else
+				*out = std::move(val);
+			++out;
+		}
+		return count;
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	template<class _InIt>
+	_InIt channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_write_range(_InIt first, _InIt last)
+	{
+		scoped_lock<lock_type> lock_(this->_lock);
+
+		//先判断能否写入，再从*first构造数据，以免写入失败时，已经从移动迭代器里取走了数据
+		for (; first != last; ++first)
+		{
+			if (!_values.full())
 			{
-				state_read_t* state = _read_awakes.front();
-				_read_awakes.pop_front();
-				return state;
+				value_type val(*first);
+				bool ret = try_write_nolock(val);
+				(void)ret;
+				assert(ret);
+			}
+			else if (state_read_t* state = try_pop_reader_())
+			{
+				*state->_value = value_type(*first);
+				state->on_notify();
+			}
+			else
+			{
+				break;
 			}
-			return nullptr;
 		}
+		return first;
 	}
 
 	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	auto channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_pop_writer_()->state_write_t*
+	auto channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_pop_reader_()->state_read_t*
 	{
-		if constexpr (USE_LINK_QUEUE)
+		for (;;)
 		{
-			return _write_awakes.try_pop();
+			state_read_t* state;
+			if constexpr (USE_LINK_QUEUE)
+			{
+				state = _read_awakes.try_pop();
+			}
+			else
+			{
+				if (_read_awakes.empty())
+					return nullptr;
+				state = _read_awakes.front();
+				_read_awakes.pop_front();
+			}
+
+			//跳过select()里已经由其他分支胜出的读者
+			if (state == nullptr || state->on_claim())
+				return state;
 		}
-		else
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	auto channel_impl_v2<_Ty, _Optional, _OptimizationThread>::try_pop_writer_()->state_write_t*
+	{
+		for (;;)
 		{
-			if (!_write_awakes.empty())
+			state_write_t* state;
+			if constexpr (USE_LINK_QUEUE)
+			{
+				state = _write_awakes.try_pop();
+			}
+			else
 			{
-				state_write_t* state = _write_awakes.front();
+				if (_write_awakes.empty())
+					return nullptr;
+				state = _write_awakes.front();
 				_write_awakes.pop_front();
-				return state;
 			}
-			return nullptr;
+
+			if (state == nullptr || state->on_claim())
+				return state;
 		}
 	}
 
@@ -324,6 +499,251 @@ namespace detail
 		}
 		return false;
 	}
+
+
+
+//-----------------------------------------------------------------------------------------------------------------------------------------
+
+	/*
+	mpsc/spsc模式的channel实现。缓存的数据放在无锁环形队列里，读写的快速路径不加锁。
+	只有在需要挂起协程，或者有协程在等待时，才加锁操作等待队列。
+
+	挂起前，先在锁内增加等待计数，再重试一次读写；对方在无锁读写成功后，检查等待计数，不为0才加锁唤醒。
+	两边在修改之后、检查之前都有一个seq_cst栅栏，故要么挂起的一方重试成功，要么对方一定能看到等待计数，不会丢失唤醒。
+	读者挂起时，由写者在锁内替它从队列里取出数据；写者挂起时，由读者在锁内替它写入队列。
+	此时被替代的一方正在等待，故环形队列的生产者(消费者)仍然只有一个。
+	*/
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	struct channel_impl_lockfree : public std::enable_shared_from_this<channel_impl_lockfree<_Ty, _Optional, _MultiProducer>>
+	{
+		using value_type = _Ty;
+		using optional_type = std::conditional_t<_Optional, std::optional<value_type>, value_type>;
+		using this_type = channel_impl_lockfree<value_type, _Optional, _MultiProducer>;
+
+		using state_read_t = state_channel_t<optional_type, this_type>;
+		using state_write_t = state_channel_t<value_type, this_type>;
+
+		channel_impl_lockfree(size_t cache_size);
+
+		bool try_read(optional_type& val);
+		template<class _Fn>
+		bool try_read_or_wait(optional_type& val, _Fn&& make_state);
+
+		bool try_write(value_type& val);
+		template<class _Fn>
+		bool try_write_or_wait(value_type& val, _Fn&& make_state);
+
+		template<class _OutIt>
+		size_t try_read_n(_OutIt& out, size_t max);
+		template<class _InIt>
+		_InIt try_write_range(_InIt first, _InIt last);
+
+		size_t capacity() const noexcept
+		{
+			return _values.capacity();
+		}
+	private:
+		bool try_read_nolock_(optional_type& val);
+		bool try_write_nolock_(value_type& val);
+		void awake_readers_();
+		void awake_writers_();
+		void awake_readers_nolock_();
+		void awake_writers_nolock_();
+
+		channel_impl_lockfree(const channel_impl_lockfree&) = delete;
+		channel_impl_lockfree(channel_impl_lockfree&&) = delete;
+		channel_impl_lockfree& operator = (const channel_impl_lockfree&) = delete;
+		channel_impl_lockfree& operator = (channel_impl_lockfree&&) = delete;
+
+		using queue_type = std::conditional_t<_MultiProducer, ring_queue_mpsc<value_type, _Optional>, ring_queue_spsc<value_type, _Optional>>;
+		using read_queue_type = intrusive_link_queue<state_read_t>;
+		using write_queue_type = intrusive_link_queue<state_write_t>;
+	public:
+		using lock_type = spinlock;
+		lock_type _lock;									//保护等待队列
+	private:
+		queue_type _values;									//数据队列
+		std::atomic<uint32_t> _read_waiting{ 0 };			//正在挂起或者已经挂起的读者数量
+		std::atomic<uint32_t> _write_waiting{ 0 };			//正在挂起或者已经挂起的写者数量
+		read_queue_type _read_awakes;						//读队列
+		write_queue_type _write_awakes;						//写队列
+	};
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::channel_impl_lockfree(size_t cache_size)
+		: _values(cache_size)
+	{
+		//无锁环形队列没有0容量的形式，不能像mpmc模式那样在读写者之间直接传递数据
+		if (cache_size == 0)
+			throw channel_exception(error_code::zero_capacity);
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	bool channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_read(optional_type& val)
+	{
+		if (!_values.try_pop(val))
+			return false;
+
+		awake_writers_();
+		return true;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	template<class _Fn>
+	bool channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_read_or_wait(optional_type& val, _Fn&& make_state)
+	{
+		scoped_lock<lock_type> lock_(this->_lock);
+
+		_read_waiting.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (try_read_nolock_(val))
+		{
+			_read_waiting.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		_read_awakes.push_back(make_state());
+		return false;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	bool channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_write(value_type& val)
+	{
+		if (!_values.try_push(std::move(val)))
+			return false;
+
+		awake_readers_();
+		return true;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	template<class _Fn>
+	bool channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_write_or_wait(value_type& val, _Fn&& make_state)
+	{
+		scoped_lock<lock_type> lock_(this->_lock);
+
+		_write_waiting.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (try_write_nolock_(val))
+		{
+			_write_waiting.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		_write_awakes.push_back(make_state());
+		return false;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	bool channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_read_nolock_(optional_type& val)
+	{
+		if (!_values.try_pop(val))
+			return false;
+
+		awake_writers_nolock_();
+		return true;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	bool channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_write_nolock_(value_type& val)
+	{
+		if (!_values.try_push(std::move(val)))
+			return false;
+
+		awake_readers_nolock_();
+		return true;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	template<class _OutIt>
+	size_t channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_read_n(_OutIt& out, size_t max)
+	{
+		size_t count = 0;
+		for (optional_type val; count < max && _values.try_pop(val); ++count)
+		{
+			if constexpr (_Optional)
+				*out = std::move(val).value();
+			else
+				*out = std::move(val);
+			++out;
+		}
+
+		if (count > 0)
+			awake_writers_();
+		return count;
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	template<class _InIt>
+	_InIt channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::try_write_range(_InIt first, _InIt last)
+	{
+		//环形队列抢到槽位后才从*first赋值，写入失败时不会取走移动迭代器里的数据
+		size_t count = 0;
+		for (; first != last && _values.try_push(*first); ++first)
+			++count;
+
+		if (count > 0)
+			awake_readers_();
+		return first;
+	}
+
+	//无锁读写成功之后调用，检查是否有挂起的对方需要唤醒
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	void channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::awake_readers_()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (unlikely(_read_waiting.load(std::memory_order_relaxed) != 0))
+		{
+			scoped_lock<lock_type> lock_(this->_lock);
+			awake_readers_nolock_();
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	void channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::awake_writers_()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (unlikely(_write_waiting.load(std::memory_order_relaxed) != 0))
+		{
+			scoped_lock<lock_type> lock_(this->_lock);
+			awake_writers_nolock_();
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	void channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::awake_readers_nolock_()
+	{
+		while (state_read_t* state = _read_awakes.try_pop())
+		{
+			//mpsc模式下，抢占了槽位但尚未写完的写者，会在写完后再来唤醒
+			if (!_values.try_pop(*state->_value))
+			{
+				_read_awakes.push_front(state);
+				break;
+			}
+
+			_read_waiting.fetch_sub(1, std::memory_order_relaxed);
+			state->on_notify();
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _MultiProducer>
+	void channel_impl_lockfree<_Ty, _Optional, _MultiProducer>::awake_writers_nolock_()
+	{
+		while (state_write_t* state = _write_awakes.try_pop())
+		{
+			if (!_values.try_push(std::move(*state->_value)))
+			{
+				_write_awakes.push_front(state);
+				break;
+			}
+
+			_write_waiting.fetch_sub(1, std::memory_order_relaxed);
+			state->on_notify();
+		}
+	}
 }	//namespace detail
 
 
@@ -331,8 +751,8 @@ namespace detail
 
 //-----------------------------------------------------------------------------------------------------------------------------------------
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	struct [[nodiscard]] channel_t<_Ty, _Optional, _OptimizationThread>::read_awaiter
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	struct [[nodiscard]] channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_awaiter
 	{
 		using state_type = typename channel_type::state_read_t;
 
@@ -349,19 +769,15 @@ namespace detail
 		~read_awaiter()
 		{//为了不在协程中也能正常使用
 			if (_channel != nullptr)
-			{
-				while(!_channel->try_read(_value));
-			}
+				read_sync_(_channel, _value);
 		}
 
 		bool await_ready()
 		{
-			//在多线程竞争较为多的时候，先检查是否可用，可以稍微提高点效率
-			if constexpr (optimization_for_multithreading)
+			//在多线程竞争较为多的时候，先检查是否可用，可以稍微提高点效率。无锁模式下，检查的代价很小
+			if constexpr (optimization_for_multithreading || mode != channel_mode::mpmc)
 			{
-				scoped_lock<lock_type> lock_(_channel->_lock);
-
-				if (_channel->try_read_nolock(_value))
+				if (_channel->try_read(_value))
 				{
 					_channel = nullptr;
 					return true;
@@ -373,20 +789,15 @@ namespace detail
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
 		bool await_suspend(coroutine_handle<_PromiseT> handler)
 		{
-			scoped_lock<lock_type> lock_(_channel->_lock);
+			//state加入读队列后，协程随时可能在其他线程恢复运行，此后不能再访问本awaiter
+			std::shared_ptr<channel_type> ch = std::move(_channel);
 
-			if (_channel->try_read_nolock(_value))
+			return !ch->try_read_or_wait(_value, [&]
 			{
-				_channel = nullptr;
-				return false;
-			}
-
-			_state = new state_type(_channel, _value);
-			_state->on_await_suspend(handler);
-			_channel->add_read_list_nolock(_state.get());
-			_channel = nullptr;
-
-			return true;
+				_state = state_type::_Alloc_state(ch, _value);
+				_state->on_await_suspend(handler);
+				return _state.get();
+			});
 		}
 		value_type await_resume()
 		{
@@ -395,14 +806,47 @@ namespace detail
 			else
 				return std::move(_value);
 		}
+
+		//以下函数供select()使用。select()持有所有分支的channel的锁，调用select_try_nolock()或者select_wait_nolock()
+		lock_type& select_lock() const noexcept
+		{
+			return _channel->_lock;
+		}
+		bool select_try_nolock()
+		{
+			static_assert(mode == channel_mode::mpmc, "select() only supports channel_mode::mpmc");
+			return _channel->try_read_nolock(_value);
+		}
+		template<class _PromiseT>
+		void select_wait_nolock(coroutine_handle<_PromiseT> handler, std::atomic<intptr_t>* winner, intptr_t index)
+		{
+			_state = state_type::_Alloc_state(_channel, _value);
+			_state->on_await_suspend(handler);
+			_state->set_select(winner, index);
+			_channel->add_read_list_nolock(_state.get());
+		}
+		//select()结束后，从等待队列里移除，并且不再在析构函数里读取
+		void select_cancel()
+		{
+			std::shared_ptr<channel_type> ch = std::move(_channel);
+			if (ch != nullptr && _state != nullptr)
+			{
+				scoped_lock<lock_type> lock_(ch->_lock);
+				ch->remove_read_list_nolock(_state.get());
+			}
+		}
+		any_t select_result()
+		{
+			return await_resume();
+		}
 	private:
 		std::shared_ptr<channel_type> _channel;
-		counted_ptr<state_type> _state;	//延迟到await_suspend()里创建，减小不必要的内存申请
+		counted_ptr<state_type> _state;	//延迟到await_suspend()里从内存池创建，不需要挂起时不分配
 		mutable optional_type _value;
 	};
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	struct [[nodiscard]] channel_t<_Ty, _Optional, _OptimizationThread>::write_awaiter
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	struct [[nodiscard]] channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_awaiter
 	{
 		using state_type = typename channel_type::state_write_t;
 
@@ -420,19 +864,15 @@ namespace detail
 		~write_awaiter()
 		{//为了不在协程中也能正常使用
 			if (_channel != nullptr)
-			{
-				while(!_channel->try_write(_value));
-			}
+				write_sync_(_channel, _value);
 		}
 
 		bool await_ready()
 		{
-			//在多线程竞争较为多的时候，先检查是否可用，可以稍微提高点效率
-			if constexpr (optimization_for_multithreading)
+			//在多线程竞争较为多的时候，先检查是否可用，可以稍微提高点效率。无锁模式下，检查的代价很小
+			if constexpr (optimization_for_multithreading || mode != channel_mode::mpmc)
 			{
-				scoped_lock<lock_type> lock_(_channel->_lock);
-
-				if (_channel->try_write_nolock(_value))
+				if (_channel->try_write(_value))
 				{
 					_channel = nullptr;
 					return true;
@@ -444,79 +884,247 @@ namespace detail
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
 		bool await_suspend(coroutine_handle<_PromiseT> handler)
 		{
-			scoped_lock<lock_type> lock_(_channel->_lock);
+			//state加入写队列后，协程随时可能在其他线程恢复运行，此后不能再访问本awaiter
+			std::shared_ptr<channel_type> ch = std::move(_channel);
 
-			if (_channel->try_write_nolock(_value))
+			return !ch->try_write_or_wait(_value, [&]
 			{
-				_channel = nullptr;
-				return false;
-			}
+				_state = state_type::_Alloc_state(ch, _value);
+				_state->on_await_suspend(handler);
+				return _state.get();
+			});
+		}
+		void await_resume()
+		{
+		}
 
-			_state = new state_type(_channel, _value);
+		//以下函数供select()使用，参见read_awaiter
+		lock_type& select_lock() const noexcept
+		{
+			return _channel->_lock;
+		}
+		bool select_try_nolock()
+		{
+			static_assert(mode == channel_mode::mpmc, "select() only supports channel_mode::mpmc");
+			return _channel->try_write_nolock(_value);
+		}
+		template<class _PromiseT>
+		void select_wait_nolock(coroutine_handle<_PromiseT> handler, std::atomic<intptr_t>* winner, intptr_t index)
+		{
+			_state = state_type::_Alloc_state(_channel, _value);
 			_state->on_await_suspend(handler);
+			_state->set_select(winner, index);
 			_channel->add_write_list_nolock(_state.get());
-			_channel = nullptr;
-
-			return true;
 		}
-		void await_resume()
+		void select_cancel()
 		{
+			std::shared_ptr<channel_type> ch = std::move(_channel);
+			if (ch != nullptr && _state != nullptr)
+			{
+				scoped_lock<lock_type> lock_(ch->_lock);
+				ch->remove_write_list_nolock(_state.get());
+			}
+		}
+		any_t select_result()
+		{
+			return {};
 		}
 	private:
 		std::shared_ptr<channel_type> _channel;
-		counted_ptr<state_type> _state;	//延迟到await_suspend()里创建，减小不必要的内存申请
+		counted_ptr<state_type> _state;	//延迟到await_suspend()里从内存池创建，不需要挂起时不分配
 		mutable value_type _value;
 	};
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	channel_t<_Ty, _Optional, _OptimizationThread>::channel_t(size_t cache_size)
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::channel_t(size_t cache_size)
 		:_chan(std::make_shared<channel_type>(cache_size))
 	{
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	channel_t<_Ty, _Optional, _OptimizationThread>::channel_t(std::adopt_lock_t)
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::channel_t(std::adopt_lock_t)
 	{
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	size_t channel_t<_Ty, _Optional, _OptimizationThread>::capacity() const noexcept
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	size_t channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::capacity() const noexcept
 	{
 		return _chan->capacity();
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	typename channel_t<_Ty, _Optional, _OptimizationThread>::read_awaiter
-		channel_t<_Ty, _Optional, _OptimizationThread>::operator co_await() const noexcept
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	typename channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_awaiter
+		channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::operator co_await() const noexcept
 	{
 		return { _chan };
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	typename channel_t<_Ty, _Optional, _OptimizationThread>::read_awaiter
-		channel_t<_Ty, _Optional, _OptimizationThread>::read() const noexcept
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	typename channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_awaiter
+		channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read() const noexcept
 	{
 		return { _chan };
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
 	template<class U> requires(std::is_constructible_v<_Ty, U&&>)
-	typename channel_t<_Ty, _Optional, _OptimizationThread>::write_awaiter
-		channel_t<_Ty, _Optional, _OptimizationThread>::write(U&& val) const noexcept(std::is_nothrow_move_constructible_v<U>)
+	typename channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_awaiter
+		channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write(U&& val) const noexcept(std::is_nothrow_move_constructible_v<U>)
 	{
 		return write_awaiter{ _chan, std::forward<U>(val) };
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
 	template<class U> requires(std::is_constructible_v<_Ty, U&&>)
-	typename channel_t<_Ty, _Optional, _OptimizationThread>::write_awaiter
-		channel_t<_Ty, _Optional, _OptimizationThread>::operator << (U&& val) const noexcept(std::is_nothrow_move_constructible_v<U>)
+	typename channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_awaiter
+		channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::operator << (U&& val) const noexcept(std::is_nothrow_move_constructible_v<U>)
 	{
 		return write_awaiter{ _chan, std::forward<U>(val) };
 	}
 
-	template<class _Ty, bool _Optional, bool _OptimizationThread>
-	bool channel_t<_Ty, _Optional, _OptimizationThread>::valid() const noexcept
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	template<class _OutIt>
+	lazy_t<size_t> channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_n(_OutIt out, size_t max) const
+	{
+		return read_n_(_chan, std::move(out), max);
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	template<class _OutIt>
+	lazy_t<size_t> channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_n_(std::shared_ptr<channel_type> ch, _OutIt out, size_t max)
+	{
+		size_t count = ch->try_read_n(out, max);
+		if (count == 0 && max > 0)
+		{
+			//没有可读的数据，等到第一个数据后，再批量读出随之可读的数据
+			*out = co_await read_awaiter{ ch };
+			++out;
+			count = 1 + ch->try_read_n(out, max - 1);
+		}
+		co_return count;
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	template<class _InIt>
+	lazy_t<> channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_range(_InIt first, _InIt last) const
+	{
+		return write_range_(_chan, std::move(first), std::move(last));
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	template<class _InIt>
+	lazy_t<> channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_range_(std::shared_ptr<channel_type> ch, _InIt first, _InIt last)
+	{
+		for (;;)
+		{
+			first = ch->try_write_range(std::move(first), last);
+			if (first == last)
+				break;
+
+			//缓冲区满了，等到写入一个数据后，再继续批量写入
+			co_await write_awaiter{ ch, *first };
+			++first;
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	bool channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::try_read(value_type& val) const
+	{
+		if constexpr (use_optional)
+		{
+			optional_type ov;
+			if (!_chan->try_read(ov))
+				return false;
+			val = std::move(ov).value();
+			return true;
+		}
+		else
+		{
+			return _chan->try_read(val);
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	template<class U> requires(std::is_constructible_v<_Ty, U&&>)
+	bool channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::try_write(U&& val) const
+	{
+		//内部实现只在写入成功时才移走数据，故value_type的右值可以直接传入，失败时保持不变
+		if constexpr (std::is_same_v<U, value_type>)
+		{
+			return _chan->try_write(val);
+		}
+		else
+		{
+			value_type tmp(std::forward<U>(val));
+			return _chan->try_write(tmp);
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	auto channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_sync() const -> value_type
+	{
+		optional_type val{};
+		read_sync_(_chan, val);
+
+		if constexpr (use_optional)
+			return std::move(val).value();
+		else
+			return val;
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	template<class U> requires(std::is_constructible_v<_Ty, U&&>)
+	void channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_sync(U&& val) const
+	{
+		if constexpr (std::is_same_v<U, value_type>)
+		{
+			write_sync_(_chan, val);
+		}
+		else
+		{
+			value_type tmp(std::forward<U>(val));
+			write_sync_(_chan, tmp);
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	void channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::read_sync_(const std::shared_ptr<channel_type>& ch, optional_type& val)
+	{
+		if constexpr (optimization_for_multithreading || mode != channel_mode::mpmc)
+		{
+			if (ch->try_read(val))
+				return;
+		}
+
+		//state放在栈上，不设置调度器，被唤醒时通知本线程
+		typename channel_type::state_read_t state{ ch, val };
+		if (!ch->try_read_or_wait(val, [&] { return &state; }))
+		{
+			state.wait_signal();
+			//唤醒者在锁内通知，取得锁之后，唤醒者不会再访问state
+			scoped_lock<lock_type> lock_(ch->_lock);
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	void channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::write_sync_(const std::shared_ptr<channel_type>& ch, value_type& val)
+	{
+		if constexpr (optimization_for_multithreading || mode != channel_mode::mpmc)
+		{
+			if (ch->try_write(val))
+				return;
+		}
+
+		typename channel_type::state_write_t state{ ch, val };
+		if (!ch->try_write_or_wait(val, [&] { return &state; }))
+		{
+			state.wait_signal();
+			scoped_lock<lock_type> lock_(ch->_lock);
+		}
+	}
+
+	template<class _Ty, bool _Optional, bool _OptimizationThread, channel_mode _Mode>
+	bool channel_t<_Ty, _Optional, _OptimizationThread, _Mode>::valid() const noexcept
 	{
 		return (bool)_chan;
 	}
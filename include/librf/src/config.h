@@ -12,6 +12,14 @@
 /* #undef RESUMEF_DISABLE_MULT_THREAD */
 #endif	//RESUMEF_DISABLE_MULT_THREAD
 
+#ifndef RESUMEF_DISABLE_POOL_ALLOCATOR
+/* #undef RESUMEF_DISABLE_POOL_ALLOCATOR */
+#endif	//RESUMEF_DISABLE_POOL_ALLOCATOR
+
+#ifndef RESUMEF_DISABLE_STATE_IN_FRAME
+/* #undef RESUMEF_DISABLE_STATE_IN_FRAME */
+#endif	//RESUMEF_DISABLE_STATE_IN_FRAME
+
 /* #undef RESUMEF_USE_CUSTOM_SPINLOCK */
 
 /* #undef RESUMEF_USE_SHARD_LIBRARY */
@@ -10,6 +10,7 @@ namespace std
 	//using experimental::suspend_if;
 	using experimental::suspend_always;
 	using experimental::suspend_never;
+	using experimental::noop_coroutine;
 }
 #endif
 
@@ -17,6 +18,7 @@ namespace librf
 {
 #ifndef DOXYGEN_SKIP_PROPERTY
 	struct scheduler_t;
+	struct scheduler_pool_t;
 
 	template<class _Ty = void>
 	struct future_t;
@@ -31,6 +33,7 @@ namespace librf
 	struct awaitable_t;
 
 	struct state_base_t;
+	struct task_t;
 
 	struct switch_scheduler_t;
 #endif	//DOXYGEN_SKIP_PROPERTY
@@ -39,6 +42,7 @@ namespace librf
 	using coroutine_handle = std::coroutine_handle<_PromiseT>;
 	using suspend_always = std::suspend_always;
 	using suspend_never = std::suspend_never;
+	using std::noop_coroutine;
 
 	template<class... _Mutexes>
 	using scoped_lock = std::scoped_lock<_Mutexes...>;
@@ -53,6 +57,19 @@ namespace librf
 	 * @brief 版本号。
 	 */
 	constexpr size_t _Version = LIB_RESUMEF_VERSION;
+
+	/**
+	 * @brief 协程的优先级。
+	 * @details 调度器总是先运行高优先级的协程。
+	 */
+	enum struct priority : uint8_t
+	{
+		high,			///< 高优先级，例如对延迟敏感的控制流程
+		normal,			///< 默认的优先级
+		low,			///< 低优先级，例如后台的批量任务
+
+		max__
+	};
 }
 
 #ifndef DOXYGEN_SKIP_PROPERTY
@@ -63,6 +80,7 @@ extern std::atomic<intptr_t> g_resumef_state_count;
 extern std::atomic<intptr_t> g_resumef_task_count;
 extern std::atomic<intptr_t> g_resumef_evtctx_count;
 extern std::atomic<intptr_t> g_resumef_state_id;
+extern std::atomic<intptr_t> g_resumef_timer_clock_count;
 #endif
 
 namespace librf
@@ -16,7 +16,7 @@ namespace librf
 	struct event_t
 	{
 		using event_impl_ptr = std::shared_ptr<detail::event_v2_impl>;
-		using clock_type = std::chrono::system_clock;
+		using clock_type = timer_manager::clock_type;
 
 		/**
 			* @brief 构造一个事件。
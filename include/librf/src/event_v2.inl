@@ -54,6 +54,11 @@ namespace librf
 		struct state_event_base_t : public state_base_t
 								  , public intrusive_link_node<state_event_base_t, counted_ptr<state_event_base_t>>
 		{
+			state_event_base_t() noexcept
+			{
+				disable_confined();
+			}
+
 			virtual void on_cancel() noexcept = 0;
 			virtual bool on_notify(event_v2_impl* eptr) = 0;
 			virtual bool on_timeout() = 0;
@@ -66,23 +71,34 @@ namespace librf
 				scheduler_t* sch = parent->get_scheduler();
 
 				this->_scheduler = sch;
+				this->_priority = parent->get_priority();
 				this->_coro = handler;
 
 				return sch;
 			}
 
-			inline void add_timeout_timer(std::chrono::system_clock::time_point tp)
+			inline void add_timeout_timer(timer_manager::time_point_type tp)
 			{
-				this->_thandler = this->_scheduler->timer()->add_handler(tp,
-					[st = counted_ptr<state_event_base_t>{ this }](bool canceld)
+				//定时器持有一个引用，在回调里释放
+				this->lock();
+				_timer.tp = tp;
+				_timer.cb = [this](bool canceld)
 					{
 						if (!canceld)
-							st->on_timeout();
-					});
+							this->on_timeout();
+						this->unlock();
+					};
+				this->_scheduler->timer()->add(&_timer);
+			}
+
+			inline void stop_timeout_timer() noexcept
+			{
+				if (_timer.is_pending())
+					this->_scheduler->timer()->stop(&_timer);
 			}
 
 		protected:
-			timer_handler _thandler;
+			timer_manager::timer_node _timer;
 		};
 
 
@@ -111,6 +127,7 @@ namespace librf
 				: _counter(count)
 				, _result(&val)
 			{
+				disable_confined();
 				_values.resize(count, sub_state_t{nullptr, nullptr});
 			}
 
@@ -126,26 +143,37 @@ namespace librf
 				scheduler_t* sch = parent->get_scheduler();
 
 				this->_scheduler = sch;
+				this->_priority = parent->get_priority();
 				this->_coro = handler;
 
 				return sch;
 			}
 
-			inline void add_timeout_timer(std::chrono::system_clock::time_point tp)
+			inline void add_timeout_timer(timer_manager::time_point_type tp)
 			{
-				this->_thandler = this->_scheduler->timer()->add_handler(tp,
-					[st = counted_ptr<state_event_all_t>{ this }](bool canceld)
+				//定时器持有一个引用，在回调里释放
+				this->lock();
+				_timer.tp = tp;
+				_timer.cb = [this](bool canceld)
 					{
 						if (!canceld)
-							st->on_timeout();
-					});
+							this->on_timeout();
+						this->unlock();
+					};
+				this->_scheduler->timer()->add(&_timer);
+			}
+
+			inline void stop_timeout_timer() noexcept
+			{
+				if (_timer.is_pending())
+					this->_scheduler->timer()->stop(&_timer);
 			}
 
 			std::vector<sub_state_t> _values;
 			intptr_t _counter;
 			event_v2_impl::lock_type _lock;
 		protected:
-			timer_handler _thandler;
+			timer_manager::timer_node _timer;
 			bool* _result;
 		};
 
@@ -282,14 +310,14 @@ namespace librf
 	template<class _Rep, class _Period>
 	inline event_t::timeout_awaiter event_t::wait_for(const std::chrono::duration<_Rep, _Period>& dt) const noexcept
 	{
-		clock_type::time_point tp2 = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(dt);
+		clock_type::time_point tp2 = this_scheduler()->timer()->now() + std::chrono::duration_cast<clock_type::duration>(dt);
 		return { tp2, _event.get() };
 	}
 
 	template<class _Clock, class _Duration>
 	inline event_t::timeout_awaiter event_t::wait_until(const std::chrono::time_point<_Clock, _Duration>& tp) const noexcept
 	{
-		clock_type::time_point tp2 = std::chrono::time_point_cast<clock_type::duration>(tp);
+		clock_type::time_point tp2 = timer_manager::to_time_point(tp);
 		return { tp2, _event.get() };
 	}
 
@@ -411,7 +439,7 @@ namespace librf
 		->event_t::timeout_any_awaiter<_Iter>
 	{
 		assert(false && "Function is flawed!");
-		clock_type::time_point tp = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(dt);
+		clock_type::time_point tp = this_scheduler()->timer()->now() + std::chrono::duration_cast<clock_type::duration>(dt);
 		return { tp, begin_, end_ };
 	}
 
@@ -421,7 +449,7 @@ namespace librf
 		->event_t::timeout_any_awaiter<decltype(std::begin(cnt_))>
 	{
 		assert(false && "Function is flawed!");
-		clock_type::time_point tp = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(dt);
+		clock_type::time_point tp = this_scheduler()->timer()->now() + std::chrono::duration_cast<clock_type::duration>(dt);
 		return { tp, std::begin(cnt_), std::end(cnt_) };
 	}
 
@@ -541,7 +569,7 @@ namespace librf
 	auto event_t::wait_all_for(const std::chrono::duration<_Rep, _Period>& dt, _Iter begin_, _Iter end_)
 		->event_t::timeout_all_awaiter<_Iter>
 	{
-		clock_type::time_point tp = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(dt);
+		clock_type::time_point tp = this_scheduler()->timer()->now() + std::chrono::duration_cast<clock_type::duration>(dt);
 		return { tp, begin_, end_ };
 	}
 
@@ -550,7 +578,7 @@ namespace librf
 	auto event_t::wait_all_for(const std::chrono::duration<_Rep, _Period>& dt, const _Cont& cnt_)
 		->event_t::timeout_all_awaiter<decltype(std::begin(cnt_))>
 	{
-		clock_type::time_point tp = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(dt);
+		clock_type::time_point tp = this_scheduler()->timer()->now() + std::chrono::duration_cast<clock_type::duration>(dt);
 		return { tp, std::begin(cnt_), std::end(cnt_) };
 	}
 }
@@ -16,6 +16,7 @@ namespace librf
 		timer_canceled,		///< 定时器被意外取消
 		not_await_lock,		///< 没有在协程中使用 co_await 等待 lock 结果
 		stop_requested,		///< stop_source 触发了
+		zero_capacity,		///< mpsc/spsc 模式的 channel，缓存的数量为0
 
 		max__
 	};
@@ -52,7 +53,7 @@ namespace librf
 	};
 
 	/**
-	 * @brief 错误使用channel_t时产生的异常(v2.0版本以后已经不再抛此异常了）。
+	 * @brief 错误使用channel_t时产生的异常(v2.0版本以后，只在mpsc/spsc模式的缓存数量为0时抛此异常）。
 	 */
 	struct channel_exception : std::logic_error
 	{
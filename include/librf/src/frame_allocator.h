@@ -0,0 +1,120 @@
+﻿#pragma once
+
+namespace librf
+{
+#ifndef DOXYGEN_SKIP_PROPERTY
+	namespace detail
+	{
+		/**
+		 * @brief 获得当前线程上，新创建的协程帧默认使用的内存资源。
+		 * @details 优先使用正在运行的调度器，其次是当前线程下的调度器。返回nullptr表示使用线程缓存内存池。
+		 * @see scheduler_t::set_frame_resource()
+		 */
+		LIBRF_API std::pmr::memory_resource* current_frame_resource() noexcept;
+
+		/**
+		 * @brief 判断当前线程上新创建的state，是否只会被当前线程访问。
+		 * @details 与current_frame_resource()一样，优先使用正在运行的调度器，其次是当前线程下的调度器。
+		 * @see scheduler_t::set_thread_confined()
+		 */
+		LIBRF_API bool current_thread_confined() noexcept;
+
+		//协程帧按默认的new对齐分配，故以这个大小为单位向分配器申请内存
+		struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_block
+		{
+			char _Data[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+		};
+
+		using frame_free_type = void(*)(void* ptr, size_t size) noexcept;
+
+		//协程帧之后，紧跟着释放函数，再之后是分配器的拷贝。协程帧释放时传入的大小与分配时相同，据此找到它们
+		constexpr size_t frame_free_offset(size_t size) noexcept
+		{
+			return (size + alignof(frame_free_type) - 1) & ~(alignof(frame_free_type) - 1);
+		}
+
+		template<class _Alloc>
+		struct frame_allocator
+		{
+			using alloc_type = typename std::allocator_traits<_Alloc>::template rebind_alloc<frame_block>;
+			using traits_type = std::allocator_traits<alloc_type>;
+			static_assert(std::is_same_v<frame_block*, typename traits_type::pointer>,
+				"coroutine frame does not support allocators with fancy pointer types");
+
+			static constexpr size_t alloc_offset(size_t size) noexcept
+			{
+				return (frame_free_offset(size) + sizeof(frame_free_type) + alignof(alloc_type) - 1) & ~(alignof(alloc_type) - 1);
+			}
+			static constexpr size_t block_count(size_t size) noexcept
+			{
+				return (alloc_offset(size) + sizeof(alloc_type) + sizeof(frame_block) - 1) / sizeof(frame_block);
+			}
+
+			static void* allocate(size_t size, const _Alloc& al)
+			{
+				static_assert(alignof(alloc_type) <= alignof(frame_block));
+
+				alloc_type _Al(al);
+				char* ptr = reinterpret_cast<char*>(traits_type::allocate(_Al, block_count(size)));
+#if RESUMEF_DEBUG_COUNTER
+				std::cout << "  frame_allocator::allocate, alloc size=" << size << ", block count=" << block_count(size) << std::endl;
+#endif
+				*reinterpret_cast<frame_free_type*>(ptr + frame_free_offset(size)) = &deallocate;
+				new(ptr + alloc_offset(size)) alloc_type(std::move(_Al));
+
+				return ptr;
+			}
+
+			static void deallocate(void* ptr, size_t size) noexcept
+			{
+				alloc_type* pal = std::launder(reinterpret_cast<alloc_type*>(static_cast<char*>(ptr) + alloc_offset(size)));
+				alloc_type _Al(std::move(*pal));
+				pal->~alloc_type();
+
+				traits_type::deallocate(_Al, static_cast<frame_block*>(ptr), block_count(size));
+			}
+		};
+
+		/**
+		 * @brief 使用调用者指定的分配器分配协程帧。
+		 * @details 分配器可以是任意的分配器，也可以是std::pmr::memory_resource*。
+		 */
+		template<class _Alloc>
+		inline void* frame_allocate(size_t size, const _Alloc& al)
+		{
+			if constexpr (std::is_convertible_v<const _Alloc&, std::pmr::memory_resource*>)
+			{
+				std::pmr::memory_resource* res = al;
+				assert(res != nullptr);
+				return frame_allocator<std::pmr::polymorphic_allocator<frame_block>>::allocate(size, std::pmr::polymorphic_allocator<frame_block>{ res });
+			}
+			else
+			{
+				return frame_allocator<_Alloc>::allocate(size, al);
+			}
+		}
+
+		/**
+		 * @brief 使用当前调度器的默认内存资源分配协程帧。
+		 * @details 调度器没有设置内存资源时，使用一个默认构造的_Alloc。
+		 */
+		template<class _Alloc = pool_allocator<char>>
+		inline void* frame_allocate(size_t size)
+		{
+			std::pmr::memory_resource* res = current_frame_resource();
+			if (res != nullptr)
+				return frame_allocator<std::pmr::polymorphic_allocator<frame_block>>::allocate(size, std::pmr::polymorphic_allocator<frame_block>{ res });
+			return frame_allocator<_Alloc>::allocate(size, _Alloc{});
+		}
+
+		/**
+		 * @brief 释放协程帧。使用分配时记录下来的分配器。
+		 */
+		inline void frame_deallocate(void* ptr, size_t size) noexcept
+		{
+			frame_free_type free_ = *reinterpret_cast<frame_free_type*>(static_cast<char*>(ptr) + frame_free_offset(size));
+			free_(ptr, size);
+		}
+	}
+#endif	//DOXYGEN_SKIP_PROPERTY
+}
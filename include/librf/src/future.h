@@ -36,13 +36,14 @@ namespace librf
 		}
 
 		template<class _PromiseT/*, typename = std::enable_if_t<traits::is_promise_v<_PromiseT>>*/>
-		void await_suspend(coroutine_handle<_PromiseT> handler) const
+		coroutine_handle<> await_suspend(coroutine_handle<_PromiseT> handler) const
 		{
-			_state->future_await_suspend(handler);
+			return _state->future_await_suspend(handler);
 		}
 
 		_Ty await_resume() const
 		{
+			_state->future_await_finalize();
 			return _state->future_await_resume();
 		}
 	};
@@ -191,15 +191,15 @@ namespace librf
 			}
 
 			using _Alloc_char = typename std::allocator_traits<_Alloc>::template rebind_alloc<char>;
-			static_assert(std::is_same_v<char*, typename std::allocator_traits<_Alloc_char>::pointer>,
-				"generator_t does not support allocators with fancy pointer types");
-			static_assert(std::allocator_traits<_Alloc_char>::is_always_equal::value,
-				"generator_t only supports stateless allocators");
 
+			//_Alloc为std::allocator时，使用当前调度器的默认内存资源，或者线程缓存内存池；否则使用一个默认构造的_Alloc
 			void* operator new(size_t _Size)
 			{
-				_Alloc_char _Al;
-				char* ptr = _Al.allocate(_Size);
+				void* ptr;
+				if constexpr (std::is_same_v<_Alloc_char, std::allocator<char>>)
+					ptr = detail::frame_allocate<detail::pool_allocator<char>>(_Size);
+				else
+					ptr = detail::frame_allocator<_Alloc_char>::allocate(_Size, _Alloc_char{});
 #if RESUMEF_DEBUG_COUNTER
 				std::cout << "  generator_promise::new, alloc size=" << _Size << std::endl;
 				std::cout << "  generator_promise::new, alloc ptr=" << (void*)ptr << std::endl;
@@ -211,8 +211,34 @@ namespace librf
 
 			void operator delete(void* _Ptr, size_t _Size)
 			{
-				_Alloc_char _Al;
-				return _Al.deallocate(reinterpret_cast<char *>(_Ptr), _Size);
+				detail::frame_deallocate(_Ptr, _Size);
+			}
+
+			/**
+			 * @brief 协程的第一个参数为std::allocator_arg时，使用第二个参数指定的分配器分配协程帧，可以是有状态的分配器。
+			 * @see promise_impl_t::operator new()
+			 */
+			template<class _Alloc2, class... _Args>
+			void* operator new(size_t _Size, std::allocator_arg_t, const _Alloc2& _Al, const _Args&...)
+			{
+				return detail::frame_allocate(_Size, _Al);
+			}
+			template<class _This, class _Alloc2, class... _Args>
+			void* operator new(size_t _Size, const _This&, std::allocator_arg_t, const _Alloc2& _Al, const _Args&...)
+			{
+				return detail::frame_allocate(_Size, _Al);
+			}
+
+			//与带分配器的operator new配对。协程帧总是通过operator delete(void*, size_t)释放，不会调用到这里
+			template<class _Alloc2, class... _Args>
+			void operator delete(void*, std::allocator_arg_t, const _Alloc2&, const _Args&...) noexcept
+			{
+				assert(false);
+			}
+			template<class _This, class _Alloc2, class... _Args>
+			void operator delete(void*, const _This&, std::allocator_arg_t, const _Alloc2&, const _Args&...) noexcept
+			{
+				assert(false);
 			}
 		private:
 			counted_ptr<state_type> _state = state_generator_t::_Alloc_state();
@@ -0,0 +1,145 @@
+﻿#pragma once
+
+namespace librf
+{
+	/**
+	 * @brief 侵入式MPSC队列的节点。
+	 * @details _mpsc_next非空，表示节点已经在队列里。故一个节点同时只能在队列里出现一次，重复的push()会被合并。
+	 */
+	template<class _Node>
+	struct intrusive_mpsc_node
+	{
+	private:
+		std::atomic<_Node*> _mpsc_next{ nullptr };
+
+		template<class _Node2>
+		friend struct intrusive_mpsc_queue;
+	};
+
+	/**
+	 * @brief 侵入式的无锁多生产者单消费者队列。
+	 * @details 生产者通过CAS将节点压入栈顶；消费者通过一次exchange取走全部节点，反转成先进先出的次序后逐个处理。\n
+	 * 生产者之间是无锁的，消费者是无等待的，且全程没有内存分配。
+	 */
+	template<class _Node>
+	struct intrusive_mpsc_queue
+	{
+		using node_type = _Node;
+
+		intrusive_mpsc_queue() noexcept = default;
+		intrusive_mpsc_queue(const intrusive_mpsc_queue&) = delete;
+		intrusive_mpsc_queue& operator =(const intrusive_mpsc_queue&) = delete;
+
+		/**
+		 * @brief 判断队列是否为空。消费者已经取走、但尚未处理的节点，不计算在内。
+		 */
+		bool empty() const noexcept
+		{
+			return _header.load(std::memory_order_acquire) == nullptr;
+		}
+
+		/**
+		 * @brief 压入一个节点，可以在任意线程调用。
+		 * @return 节点已经在队列里(包括已经被消费者取走但尚未release()的)，则返回false。
+		 */
+		bool push(node_type* node) noexcept
+		{
+			assert(node != nullptr);
+
+			if (!claim(node))
+				return false;
+			push_claimed(node);
+
+			return true;
+		}
+
+		/**
+		 * @brief 标记节点进入队列，可以在任意线程调用。
+		 * @details 成功后，节点可以通过push_claimed()压入本队列，或者由调用者自行通过set_next()链接到一个非共享的链表里。
+		 * @return 节点已经在队列里(包括已经被消费者取走但尚未release()的)，则返回false。
+		 */
+		static bool claim(node_type* node) noexcept
+		{
+			node_type* expected = nullptr;
+			return node->_mpsc_next.compare_exchange_strong(expected, _End(), std::memory_order_acq_rel, std::memory_order_acquire);
+		}
+
+		/**
+		 * @brief 压入一个已经通过claim()标记过的节点，可以在任意线程调用。
+		 */
+		void push_claimed(node_type* node) noexcept
+		{
+			node_type* header = _header.load(std::memory_order_relaxed);
+			do
+			{
+				node->_mpsc_next.store(header != nullptr ? header : _End(), std::memory_order_relaxed);
+			} while (!_header.compare_exchange_weak(header, node, std::memory_order_release, std::memory_order_relaxed));
+		}
+
+		/**
+		 * @brief 取走全部节点，只能在消费者线程调用。
+		 * @param count 返回取走的节点数量。
+		 * @return 按压入的先后次序排列的节点链表，通过next()遍历。
+		 */
+		node_type* pop_all(size_t& count) noexcept
+		{
+			node_type* tail;
+			return pop_all(count, tail);
+		}
+
+		/**
+		 * @brief 取走全部节点，并返回链表的最后一个节点，以便于将链表拼接到其他链表的前面。
+		 */
+		node_type* pop_all(size_t& count, node_type*& tail) noexcept
+		{
+			node_type* node = _header.exchange(nullptr, std::memory_order_acquire);
+			//最后压入的节点，反转后成为链表的最后一个节点
+			tail = node != _End() ? node : nullptr;
+
+			node_type* first = _End();
+			count = 0;
+			while (node != nullptr && node != _End())
+			{
+				node_type* next = node->_mpsc_next.load(std::memory_order_relaxed);
+				node->_mpsc_next.store(first, std::memory_order_relaxed);
+				first = node;
+				node = next;
+				++count;
+			}
+
+			return first != _End() ? first : nullptr;
+		}
+
+		/**
+		 * @brief 获得pop_all()返回的链表里的下一个节点。必须在release()之前调用。
+		 */
+		static node_type* next(node_type* node) noexcept
+		{
+			node_type* next = node->_mpsc_next.load(std::memory_order_relaxed);
+			return next != _End() ? next : nullptr;
+		}
+
+		/**
+		 * @brief 将pop_all()返回的链表里的下一个节点改为next。
+		 */
+		static void set_next(node_type* node, node_type* next) noexcept
+		{
+			node->_mpsc_next.store(next != nullptr ? next : _End(), std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 标记节点已经离开队列。此后，节点可以被再次push()。
+		 */
+		static void release(node_type* node) noexcept
+		{
+			node->_mpsc_next.store(nullptr, std::memory_order_release);
+		}
+	private:
+		std::atomic<node_type*> _header{ nullptr };
+
+		static node_type* _End() noexcept
+		{
+			return reinterpret_cast<node_type*>(static_cast<uintptr_t>(1));
+		}
+	};
+}
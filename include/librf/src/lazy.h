@@ -0,0 +1,280 @@
+﻿//只在被co_await时才开始运行的协程
+//
+#pragma once
+
+#pragma push_macro("new")
+#undef new
+
+namespace librf
+{
+	template<class _Ty = void>
+	struct lazy_t;
+
+#ifndef DOXYGEN_SKIP_PROPERTY
+	namespace detail
+	{
+		/*
+		lazy_t<>的协程不拥有state，也不加入调度器。
+		被co_await时，记录等待者的协程句柄，以及等待者所属的state，然后通过对称转移直接开始运行。
+		get_state()返回等待者所属的state，故在lazy_t<>的协程里，可以co_await librf的其他可等待对象：
+		这些可等待对象将lazy_t<>的协程句柄当作等待者，调度器、优先级以及via()的切换都沿用等待者的协程链。
+		协程结束时，在final_suspend处通过对称转移恢复等待者。协程帧由lazy_t<>析构时销毁。
+		*/
+		template<class _Ty>
+		struct lazy_promise_base_t
+		{
+			using _Alloc_char = pool_allocator<char>;
+
+			suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			struct final_awaiter
+			{
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+				template<class _PromiseT>
+				coroutine_handle<> await_suspend(coroutine_handle<_PromiseT> handler) noexcept
+				{
+					return handler.promise()._continuation;
+				}
+				void await_resume() const noexcept
+				{
+				}
+			};
+
+			final_awaiter final_suspend() noexcept
+			{
+				return {};
+			}
+
+			template <typename _Uty>
+			_Uty&& await_transform(_Uty&& _Whatever) noexcept
+			{
+				if constexpr (traits::has_state_v<_Uty>)
+				{
+					_Whatever._state->set_scheduler(get_state()->get_scheduler());
+				}
+
+				return std::forward<_Uty>(_Whatever);
+			}
+
+			void unhandled_exception() noexcept
+			{
+				_exception = std::current_exception();
+			}
+
+			state_future_t* get_state() const noexcept
+			{
+				assert(_parent != nullptr);
+				return _parent;
+			}
+
+			void set_continuation(coroutine_handle<> handler, state_future_t* parent) noexcept
+			{
+				_continuation = handler;
+				_parent = parent;
+			}
+
+			void rethrow_if_exception()
+			{
+				if (_exception)
+					std::rethrow_exception(std::move(_exception));
+			}
+
+			void* operator new(size_t _Size)
+			{
+				return frame_allocate<_Alloc_char>(_Size);
+			}
+			void operator delete(void* _Ptr, size_t _Size)
+			{
+				frame_deallocate(_Ptr, _Size);
+			}
+
+			/**
+			 * @brief 协程的第一个参数为std::allocator_arg时，使用第二个参数指定的分配器分配协程帧。
+			 * @see promise_impl_t::operator new()
+			 */
+			template<class _Alloc, class... _Args>
+			void* operator new(size_t _Size, std::allocator_arg_t, const _Alloc& _Al, const _Args&...)
+			{
+				return frame_allocate(_Size, _Al);
+			}
+			template<class _This, class _Alloc, class... _Args>
+			void* operator new(size_t _Size, const _This&, std::allocator_arg_t, const _Alloc& _Al, const _Args&... _Rest)
+			{
+				return operator new(_Size, std::allocator_arg, _Al, _Rest...);
+			}
+
+			//与带分配器的operator new配对。协程帧总是通过operator delete(void*, size_t)释放，不会调用到这里
+			template<class _Alloc, class... _Args>
+			void operator delete(void*, std::allocator_arg_t, const _Alloc&, const _Args&...) noexcept
+			{
+				assert(false);
+			}
+			template<class _This, class _Alloc, class... _Args>
+			void operator delete(void*, const _This&, std::allocator_arg_t, const _Alloc&, const _Args&...) noexcept
+			{
+				assert(false);
+			}
+
+			coroutine_handle<> _continuation;
+		private:
+			state_future_t* _parent = nullptr;
+			std::exception_ptr _exception;
+		};
+
+		template<class _Ty>
+		struct lazy_promise_t final : public lazy_promise_base_t<_Ty>
+		{
+			lazy_t<_Ty> get_return_object() noexcept;
+
+			template<class U>
+			void return_value(U&& val)	//co_return val
+			{
+				_value.emplace(std::forward<U>(val));
+			}
+
+			_Ty get_value()
+			{
+				this->rethrow_if_exception();
+				assert(_value.has_value());
+				return std::move(*_value);
+			}
+		private:
+			std::optional<_Ty> _value;
+		};
+
+		template<class _Ty>
+		struct lazy_promise_t<_Ty&> final : public lazy_promise_base_t<_Ty&>
+		{
+			lazy_t<_Ty&> get_return_object() noexcept;
+
+			void return_value(_Ty& val)	//co_return val
+			{
+				_value = std::addressof(val);
+			}
+
+			_Ty& get_value()
+			{
+				this->rethrow_if_exception();
+				assert(_value != nullptr);
+				return *_value;
+			}
+		private:
+			_Ty* _value = nullptr;
+		};
+
+		template<>
+		struct lazy_promise_t<void> final : public lazy_promise_base_t<void>
+		{
+			lazy_t<void> get_return_object() noexcept;
+
+			void return_void()			//co_return;
+			{
+			}
+
+			void get_value()
+			{
+				this->rethrow_if_exception();
+			}
+		};
+	}
+
+	namespace traits
+	{
+		//lazy_t<>的promise沿用等待者的state，故librf的可等待对象都可以在lazy_t<>的协程里使用
+		template<class _Ty>
+		struct is_promise<librf::detail::lazy_promise_t<_Ty>> : std::true_type {};
+	}
+#endif	//DOXYGEN_SKIP_PROPERTY
+
+	/**
+	 * @brief 惰性启动的协程的返回值。
+	 * @details 与future_t<>不同，协程创建后不会开始运行，也不会加入调度器，直到被co_await时，才通过对称转移在等待者所在的线程里直接开始运行。
+	 * 协程结束后，同样通过对称转移直接恢复等待者。因此，在大部分时间同步完成的深层调用里，不需要经过调度器，也不分配state。\n
+	 * 协程帧的生存期不超过调用者的co_await表达式，编译器可以据此省略协程帧的分配(HALO)。\n
+	 * 在lazy_t<>的协程里，可以co_await librf的其他可等待对象，其所属的调度器、优先级等，都沿用等待者的协程链。\n
+	 * 只能在librf的协程(future_t<>或者lazy_t<>)里被co_await一次，不能通过go/GO加入调度器。
+	 */
+	template<class _Ty>
+	struct [[nodiscard]] lazy_t
+	{
+		using promise_type = detail::lazy_promise_t<_Ty>;
+		using value_type = _Ty;
+
+		explicit lazy_t(coroutine_handle<promise_type> handler) noexcept
+			: _coro(handler)
+		{
+		}
+		lazy_t(lazy_t&& _Right) noexcept
+			: _coro(std::exchange(_Right._coro, nullptr))
+		{
+		}
+		lazy_t& operator = (lazy_t&& _Right) noexcept
+		{
+			if (this != std::addressof(_Right))
+			{
+				if (_coro)
+					_coro.destroy();
+				_coro = std::exchange(_Right._coro, nullptr);
+			}
+			return *this;
+		}
+		lazy_t(const lazy_t&) = delete;
+		lazy_t& operator = (const lazy_t&) = delete;
+
+		~lazy_t()
+		{
+			if (_coro)
+				_coro.destroy();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return !_coro || _coro.done();
+		}
+
+		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
+		coroutine_handle<> await_suspend(coroutine_handle<_PromiseT> handler) noexcept
+		{
+			_coro.promise().set_continuation(handler, handler.promise().get_state());
+			return _coro;
+		}
+
+		_Ty await_resume()
+		{
+			assert((bool)_coro);
+			return _coro.promise().get_value();
+		}
+	private:
+		coroutine_handle<promise_type> _coro;
+	};
+
+#ifndef DOXYGEN_SKIP_PROPERTY
+	namespace detail
+	{
+		template<class _Ty>
+		inline lazy_t<_Ty> lazy_promise_t<_Ty>::get_return_object() noexcept
+		{
+			return lazy_t<_Ty>{ coroutine_handle<lazy_promise_t>::from_promise(*this) };
+		}
+
+		template<class _Ty>
+		inline lazy_t<_Ty&> lazy_promise_t<_Ty&>::get_return_object() noexcept
+		{
+			return lazy_t<_Ty&>{ coroutine_handle<lazy_promise_t>::from_promise(*this) };
+		}
+
+		inline lazy_t<void> lazy_promise_t<void>::get_return_object() noexcept
+		{
+			return lazy_t<void>{ coroutine_handle<lazy_promise_t>::from_promise(*this) };
+		}
+	}
+#endif	//DOXYGEN_SKIP_PROPERTY
+}
+
+#pragma pop_macro("new")
@@ -200,7 +200,7 @@ namespace librf
 
 #ifndef DOXYGEN_SKIP_PROPERTY
 		typedef std::shared_ptr<detail::mutex_v2_impl> mutex_impl_ptr;
-		typedef std::chrono::system_clock clock_type;
+		typedef timer_manager::clock_type clock_type;
 	private:
 		struct _MutexAwaitAssembleT;
 
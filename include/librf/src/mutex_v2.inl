@@ -8,7 +8,9 @@ namespace librf
 		{
 			state_mutex_t(mutex_v2_impl*& val)
 				: _value(&val)
-			{}
+			{
+				disable_confined();
+			}
 
 			LIBRF_API virtual void resume() override;
 			LIBRF_API virtual bool has_handler() const  noexcept override;
@@ -18,23 +20,30 @@ namespace librf
 			LIBRF_API bool on_notify(mutex_v2_impl* eptr);
 			LIBRF_API bool on_timeout();
 
-			LIBRF_API void add_timeout_timer(std::chrono::system_clock::time_point tp);
+			LIBRF_API void add_timeout_timer(timer_manager::time_point_type tp);
+
+			inline void stop_timeout_timer() noexcept
+			{
+				if (_timer.is_pending())
+					this->_scheduler->timer()->stop(&_timer);
+			}
 
 			inline void on_await_suspend(coroutine_handle<> handler, scheduler_t* sch, state_base_t* root) noexcept
 			{
 				this->_scheduler = sch;
+				this->_priority = root->get_priority();
 				this->_coro = handler;
 				this->_root = root;
 			}
 		protected:
-			timer_handler _thandler;
+			timer_manager::timer_node _timer;
 			state_base_t* _root;
 			std::atomic<mutex_v2_impl**> _value;
 		};
 
 		struct mutex_v2_impl : public std::enable_shared_from_this<mutex_v2_impl>
 		{
-			using clock_type = std::chrono::system_clock;
+			using clock_type = timer_manager::clock_type;
 
 			mutex_v2_impl() {}
 
@@ -395,13 +404,13 @@ namespace librf
 	template <class _Rep, class _Period>
 	inline mutex_t::timeout_awaiter mutex_t::try_lock_until(const std::chrono::time_point<_Rep, _Period>& tp) const noexcept
 	{
-		return { tp, _mutex.get() };
+		return { timer_manager::to_time_point(tp), _mutex.get() };
 	}
 
 	template <class _Rep, class _Period>
 	inline mutex_t::timeout_awaiter mutex_t::try_lock_for(const std::chrono::duration<_Rep, _Period>& dt) const noexcept
 	{
-		auto tp = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(dt);
+		auto tp = this_scheduler()->timer()->now() + std::chrono::duration_cast<clock_type::duration>(dt);
 		return { tp, _mutex.get() };
 	}
 
@@ -429,7 +438,7 @@ namespace librf
 	inline bool mutex_t::try_lock_until(const std::chrono::time_point<_Rep, _Period>& tp, void* unique_address)
 	{
 		assert(unique_address != nullptr);
-		return _mutex->try_lock_until(std::chrono::time_point_cast<clock_type::time_point>(tp), unique_address);
+		return _mutex->try_lock_until(timer_manager::to_time_point(tp), unique_address);
 	}
 
 	inline void mutex_t::unlock(void* unique_address) const
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+namespace librf
+{
+#ifndef DOXYGEN_SKIP_PROPERTY
+	namespace detail
+	{
+		/**
+		 * @brief 按大小分级的线程缓存内存池，用于协程帧和state。
+		 * @details 不超过pool_max_size的内存块，按pool_size_step向上取整分级。每个线程拥有一个堆，每个级别一个空闲链表，
+		 * 分配和在本线程释放都不需要加锁。\n
+		 * 内存块从按pool_chunk_size对齐的大块里切分出来，每个大块只切分一个级别，大块的头部记录所属的堆。
+		 * 在其他线程释放的内存块，通过无锁的远程释放链表还给所属的堆，由所属的线程在下一次分配时回收。\n
+		 * 整个大块都空闲时，每个堆最多保留pool_max_empty_chunks个，超过的归还给系统。\n
+		 * 线程退出时，归还所有空闲的大块；仍有大块在使用时，其堆被放弃，由之后新建的线程接管，否则销毁这个堆。\n
+		 * 释放时必须提供与分配时相同的大小。\n
+		 * 定义了RESUMEF_DISABLE_POOL_ALLOCATOR时，直接使用operator new/delete。
+		 */
+		constexpr size_t pool_size_step = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+		constexpr size_t pool_max_size = 1024;
+		constexpr size_t pool_chunk_size = 64 * 1024;
+		constexpr size_t pool_max_empty_chunks = 64;
+
+		LIBRF_API void* pool_allocate(size_t size);
+		LIBRF_API void pool_deallocate(void* ptr, size_t size) noexcept;
+
+		/**
+		 * @brief 使用线程缓存内存池的无状态分配器。
+		 */
+		template<class _Ty>
+		struct pool_allocator
+		{
+			using value_type = _Ty;
+			using is_always_equal = std::true_type;
+
+			pool_allocator() noexcept = default;
+			template<class _Other>
+			pool_allocator(const pool_allocator<_Other>&) noexcept {}
+
+			_Ty* allocate(size_t count)
+			{
+				static_assert(alignof(_Ty) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+				return static_cast<_Ty*>(pool_allocate(count * sizeof(_Ty)));
+			}
+			void deallocate(_Ty* ptr, size_t count) noexcept
+			{
+				pool_deallocate(ptr, count * sizeof(_Ty));
+			}
+
+			template<class _Other>
+			bool operator == (const pool_allocator<_Other>&) const noexcept
+			{
+				return true;
+			}
+		};
+	}
+#endif	//DOXYGEN_SKIP_PROPERTY
+}
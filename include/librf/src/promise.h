@@ -37,11 +37,11 @@ namespace librf
 			return false;
 		}
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
-		inline void await_suspend(coroutine_handle<_PromiseT> handler) noexcept
+		inline coroutine_handle<> await_suspend(coroutine_handle<_PromiseT> handler) noexcept
 		{
 			_PromiseT& promise = handler.promise();
 			auto _state = promise.ref_state();
-			_state->promise_final_suspend(handler);
+			return _state->promise_final_suspend(handler);
 		}
 		inline void await_resume() noexcept
 		{
@@ -96,7 +96,7 @@ namespace librf
 
 		void unhandled_exception()		//If the coroutine ends with an uncaught exception, it performs the following: 
 		{
-			this->ref_state()->set_exception(std::current_exception());
+			this->ref_state()->promise_unhandled_exception(std::current_exception());
 		}
 
 		void cancellation_requested() noexcept
@@ -104,11 +104,55 @@ namespace librf
 
 		}
 
-		using _Alloc_char = std::allocator<char>;
+		using _Alloc_char = detail::pool_allocator<char>;
 		void* operator new(size_t _Size);
 		void operator delete(void* _Ptr, size_t _Size);
+
+		/**
+		 * @brief 协程的第一个参数为std::allocator_arg时，使用第二个参数指定的分配器分配协程帧。
+		 * @details 分配器可以是任意的分配器，例如std::pmr::polymorphic_allocator<>；也可以是std::pmr::memory_resource*。\n
+		 * 分配器的拷贝保存在协程帧之后，用于释放协程帧。
+		 */
+		template<class _Alloc, class... _Args>
+		void* operator new(size_t _Size, std::allocator_arg_t, const _Alloc& _Al, const _Args&...)
+		{
+#if RESUMEF_DISABLE_STATE_IN_FRAME
+			return detail::frame_allocate(_Size, _Al);
+#else
+			constexpr size_t _State_size = state_future_t::_Frame_state_size<state_type>();
+			void* ptr = detail::frame_allocate(_State_size + _Size, _Al);
+			return state_future_t::_Construct_frame_state<state_type>(ptr, _State_size + _Size);
+#endif
+		}
+		/**
+		 * @brief 成员函数(包括lambda)形式的协程，跳过对象参数之后，第一个参数为std::allocator_arg时，使用第二个参数指定的分配器分配协程帧。
+		 */
+		template<class _This, class _Alloc, class... _Args>
+		void* operator new(size_t _Size, const _This&, std::allocator_arg_t, const _Alloc& _Al, const _Args&... _Rest)
+		{
+			return operator new(_Size, std::allocator_arg, _Al, _Rest...);
+		}
+
+		/**
+		 * @brief 与带分配器的operator new配对的placement delete。
+		 * @details 协程帧总是通过operator delete(void*, size_t)释放，包括协程初始化时抛出异常的情形，故这两个重载不会被调用。
+		 */
+		template<class _Alloc, class... _Args>
+		void operator delete(void*, std::allocator_arg_t, const _Alloc&, const _Args&...) noexcept
+		{
+			assert(false);
+		}
+		template<class _This, class _Alloc, class... _Args>
+		void operator delete(void*, const _This&, std::allocator_arg_t, const _Alloc&, const _Args&...) noexcept
+		{
+			assert(false);
+		}
 	private:
+#if RESUMEF_DISABLE_STATE_IN_FRAME
 		counted_ptr<state_type> _state = state_future_t::_Alloc_state<state_type>(false);
+#else
+		counted_ptr<state_type> _state = state_future_t::_Take_frame_state<state_type>(false);
+#endif
 	};
 
 	template<class _Ty>
@@ -120,7 +164,7 @@ namespace librf
 		template<class U>
 		void return_value(U&& val)	//co_return val
 		{
-			this->ref_state()->set_value(std::forward<U>(val));
+			this->ref_state()->promise_return_value(std::forward<U>(val));
 		}
 
 		template<class U>
@@ -139,7 +183,7 @@ namespace librf
 
 		void return_value(_Ty& val)	//co_return val
 		{
-			this->ref_state()->set_value(val);
+			this->ref_state()->promise_return_value(val);
 		}
 
 		suspend_always yield_value(_Ty& val)
@@ -156,7 +200,7 @@ namespace librf
 
 		void return_void()			//co_return;
 		{
-			this->ref_state()->set_value();
+			this->ref_state()->promise_return_value();
 		}
 
 		suspend_always yield_value()
@@ -37,8 +37,13 @@ namespace librf
 	template <typename _Ty>
 	void* promise_impl_t<_Ty>::operator new(size_t _Size)
 	{
-		_Alloc_char _Al;
-		char* ptr = _Al.allocate(_Size);
+#if RESUMEF_DISABLE_STATE_IN_FRAME
+		void* ptr = detail::frame_allocate<_Alloc_char>(_Size);
+#else
+		//state与协程帧分配在一起，省掉一次分配
+		constexpr size_t _State_size = state_future_t::_Frame_state_size<state_type>();
+		void* ptr = state_future_t::_Construct_frame_state<state_type>(detail::frame_allocate<_Alloc_char>(_State_size + _Size), _State_size + _Size);
+#endif
 #if RESUMEF_DEBUG_COUNTER
 		std::cout << "  future_promise::new, alloc size=" << (_Size) << std::endl;
 		std::cout << "  future_promise::new, alloc ptr=" << (void*)ptr << std::endl;
@@ -50,8 +55,13 @@ namespace librf
 	template <typename _Ty>
 	void promise_impl_t<_Ty>::operator delete(void* _Ptr, size_t _Size)
 	{
-		_Alloc_char _Al;
-		return _Al.deallocate(reinterpret_cast<char*>(_Ptr), _Size);
+#if RESUMEF_DISABLE_STATE_IN_FRAME
+		detail::frame_deallocate(_Ptr, _Size);
+#else
+		//释放替协程帧持有的引用。future_t仍然持有state时，等到state销毁时才释放内存
+		(void)_Size;
+		state_future_t::_Release_frame_state<state_type>(_Ptr);
+#endif
 	}
 }
 
@@ -57,6 +57,9 @@ namespace librf
 		friend scheduler_t;
 		counted_ptr<state_base_t> _state;
 		stop_source _stop;
+		//调度器通过侵入式双向链表管理task_t，注册和注销都是O(1)的，且不需要分配内存
+		task_t* _prev_task = nullptr;
+		task_t* _next_task = nullptr;
 	};
 #endif
 
@@ -0,0 +1,253 @@
+﻿#pragma once
+
+namespace librf
+{
+	//读写索引分别独占一个缓存行，避免生产者和消费者之间的伪共享
+	constexpr size_t ring_queue_cache_line = 64;
+
+	//无锁的单生产者单消费者环形队列。
+	//同一时刻只能有一个线程push，一个线程pop。如果通过其他同步手段保证了先后次序，push和pop的线程可以更换。
+	//_Option : 如果队列保存的数据不支持拷贝只支持移动，则需要设置为true；或者数据希望pop后销毁，都需要设置为true。
+	//容量至少为1，构造时传入0按1处理。
+	template<class _Ty, bool _Option = false>
+	struct ring_queue_spsc
+	{
+		using value_type = _Ty;
+		using size_type = size_t;
+
+		static constexpr bool use_option = _Option;
+		using optional_type = std::conditional_t<use_option, std::optional<value_type>, value_type>;
+	public:
+		ring_queue_spsc(size_t sz);
+
+		ring_queue_spsc(const ring_queue_spsc&) = delete;
+		ring_queue_spsc& operator =(const ring_queue_spsc&) = delete;
+
+		auto size() const noexcept->size_type;
+		auto capacity() const noexcept->size_type;
+		bool empty() const noexcept;
+		template<class U>
+		bool try_push(U&& value) noexcept(std::is_nothrow_assignable_v<optional_type&, U&&>);
+		template<class U>
+		bool try_pop(U& value) noexcept(std::is_nothrow_move_assignable_v<value_type>);
+	private:
+		using container_type = std::unique_ptr<optional_type[]>;
+		container_type m_bufferPtr;
+		size_type m_bufferSize;
+
+		//索引单调递增，对m_bufferSize取模后才是数组下标
+		alignas(ring_queue_cache_line) std::atomic<size_type> m_writeIndex;
+		size_type m_readCache;							//生产者看到的读索引，只在认为队列已满时才重新读取
+		alignas(ring_queue_cache_line) std::atomic<size_type> m_readIndex;
+		size_type m_writeCache;							//消费者看到的写索引，只在认为队列为空时才重新读取
+	};
+
+	template<class _Ty, bool _Option>
+	ring_queue_spsc<_Ty, _Option>::ring_queue_spsc(size_t sz)
+		: m_bufferPtr(new optional_type[sz > 0 ? sz : 1])
+		, m_bufferSize(sz > 0 ? sz : 1)
+		, m_writeIndex(0)
+		, m_readCache(0)
+		, m_readIndex(0)
+		, m_writeCache(0)
+	{
+	}
+
+	template<class _Ty, bool _Option>
+	auto ring_queue_spsc<_Ty, _Option>::size() const noexcept->size_type
+	{
+		size_type readIndex = m_readIndex.load(std::memory_order_acquire);
+		return m_writeIndex.load(std::memory_order_acquire) - readIndex;
+	}
+
+	template<class _Ty, bool _Option>
+	auto ring_queue_spsc<_Ty, _Option>::capacity() const noexcept->size_type
+	{
+		return m_bufferSize;
+	}
+
+	template<class _Ty, bool _Option>
+	bool ring_queue_spsc<_Ty, _Option>::empty() const noexcept
+	{
+		return m_readIndex.load(std::memory_order_acquire) == m_writeIndex.load(std::memory_order_acquire);
+	}
+
+	template<class _Ty, bool _Option>
+	template<class U>
+	bool ring_queue_spsc<_Ty, _Option>::try_push(U&& value) noexcept(std::is_nothrow_assignable_v<optional_type&, U&&>)
+	{
+		size_type writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex - m_readCache >= m_bufferSize)
+		{
+			m_readCache = m_readIndex.load(std::memory_order_acquire);
+			if (writeIndex - m_readCache >= m_bufferSize)
+				return false;
+		}
+
+		m_bufferPtr[writeIndex % m_bufferSize] = std::forward<U>(value);
+		m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	template<class _Ty, bool _Option>
+	template<class U>
+	bool ring_queue_spsc<_Ty, _Option>::try_pop(U& value) noexcept(std::is_nothrow_move_assignable_v<value_type>)
+	{
+		size_type readIndex = m_readIndex.load(std::memory_order_relaxed);
+		if (readIndex == m_writeCache)
+		{
+			m_writeCache = m_writeIndex.load(std::memory_order_acquire);
+			if (readIndex == m_writeCache)
+				return false;
+		}
+
+		optional_type& ov = m_bufferPtr[readIndex % m_bufferSize];
+		if constexpr (use_option)
+		{
+			value = std::move(ov).value();
+			ov = std::nullopt;
+		}
+		else
+		{
+			value = std::move(ov);
+		}
+
+		m_readIndex.store(readIndex + 1, std::memory_order_release);
+		return true;
+	}
+
+
+
+	//无锁的多生产者单消费者环形队列。每个槽位带有一个序号，生产者通过CAS抢占写索引(Dmitry Vyukov的有界队列)。
+	//支持多个线程同时push，同一时刻只能有一个线程pop。
+	//某个生产者抢占了槽位但尚未写完时，之后的槽位即使已经写好，pop也会认为队列为空。
+	//容量至少为1，构造时传入0按1处理。
+	template<class _Ty, bool _Option = false>
+	struct ring_queue_mpsc
+	{
+		using value_type = _Ty;
+		using size_type = size_t;
+
+		static constexpr bool use_option = _Option;
+		using optional_type = std::conditional_t<use_option, std::optional<value_type>, value_type>;
+	public:
+		ring_queue_mpsc(size_t sz);
+
+		ring_queue_mpsc(const ring_queue_mpsc&) = delete;
+		ring_queue_mpsc& operator =(const ring_queue_mpsc&) = delete;
+
+		auto size() const noexcept->size_type;
+		auto capacity() const noexcept->size_type;
+		bool empty() const noexcept;
+		template<class U>
+		bool try_push(U&& value) noexcept(std::is_nothrow_assignable_v<optional_type&, U&&>);
+		template<class U>
+		bool try_pop(U& value) noexcept(std::is_nothrow_move_assignable_v<value_type>);
+	private:
+		struct slot_type
+		{
+			//序号按索引的两倍计数：等于索引*2时可写；等于索引*2+1时可读；读完后设为(索引+m_bufferSize)*2，留给下一圈写入。
+			//若直接用索引计数，容量为1时，“索引i可读”与“索引i+1可写”是同一个值，写者会覆盖尚未读走的数据
+			std::atomic<size_type> _sequence;
+			optional_type _value;
+		};
+
+		using container_type = std::unique_ptr<slot_type[]>;
+		container_type m_bufferPtr;
+		size_type m_bufferSize;
+
+		alignas(ring_queue_cache_line) std::atomic<size_type> m_writeIndex;
+		alignas(ring_queue_cache_line) std::atomic<size_type> m_readIndex;
+	};
+
+	template<class _Ty, bool _Option>
+	ring_queue_mpsc<_Ty, _Option>::ring_queue_mpsc(size_t sz)
+		: m_bufferPtr(new slot_type[sz > 0 ? sz : 1])
+		, m_bufferSize(sz > 0 ? sz : 1)
+		, m_writeIndex(0)
+		, m_readIndex(0)
+	{
+		for (size_type i = 0; i < m_bufferSize; ++i)
+			m_bufferPtr[i]._sequence.store(i * 2, std::memory_order_relaxed);
+	}
+
+	template<class _Ty, bool _Option>
+	auto ring_queue_mpsc<_Ty, _Option>::size() const noexcept->size_type
+	{
+		size_type readIndex = m_readIndex.load(std::memory_order_acquire);
+		size_type writeIndex = m_writeIndex.load(std::memory_order_acquire);
+		return writeIndex > readIndex ? writeIndex - readIndex : 0;
+	}
+
+	template<class _Ty, bool _Option>
+	auto ring_queue_mpsc<_Ty, _Option>::capacity() const noexcept->size_type
+	{
+		return m_bufferSize;
+	}
+
+	template<class _Ty, bool _Option>
+	bool ring_queue_mpsc<_Ty, _Option>::empty() const noexcept
+	{
+		size_type readIndex = m_readIndex.load(std::memory_order_acquire);
+		const slot_type& slot = m_bufferPtr[readIndex % m_bufferSize];
+		return slot._sequence.load(std::memory_order_acquire) != readIndex * 2 + 1;
+	}
+
+	template<class _Ty, bool _Option>
+	template<class U>
+	bool ring_queue_mpsc<_Ty, _Option>::try_push(U&& value) noexcept(std::is_nothrow_assignable_v<optional_type&, U&&>)
+	{
+		size_type writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			slot_type& slot = m_bufferPtr[writeIndex % m_bufferSize];
+			size_type sequence = slot._sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(sequence - writeIndex * 2);
+
+			if (diff == 0)
+			{
+				if (m_writeIndex.compare_exchange_weak(writeIndex, writeIndex + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+				{
+					slot._value = std::forward<U>(value);
+					slot._sequence.store(writeIndex * 2 + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				//这个槽位上一圈的数据还没有被读走，队列已满
+				return false;
+			}
+			else
+			{
+				writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	template<class _Ty, bool _Option>
+	template<class U>
+	bool ring_queue_mpsc<_Ty, _Option>::try_pop(U& value) noexcept(std::is_nothrow_move_assignable_v<value_type>)
+	{
+		size_type readIndex = m_readIndex.load(std::memory_order_relaxed);
+		slot_type& slot = m_bufferPtr[readIndex % m_bufferSize];
+		if (slot._sequence.load(std::memory_order_acquire) != readIndex * 2 + 1)
+			return false;
+
+		optional_type& ov = slot._value;
+		if constexpr (use_option)
+		{
+			value = std::move(ov).value();
+			ov = std::nullopt;
+		}
+		else
+		{
+			value = std::move(ov);
+		}
+
+		m_readIndex.store(readIndex + 1, std::memory_order_relaxed);
+		slot._sequence.store((readIndex + m_bufferSize) * 2, std::memory_order_release);
+		return true;
+	}
+}
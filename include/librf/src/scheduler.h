@@ -16,24 +16,86 @@ namespace librf
 	{
 	private:
 		using state_sptr = counted_ptr<state_base_t>;
-		using state_vector = std::vector<state_sptr>;
+		using ready_queue_type = intrusive_mpsc_queue<state_base_t>;
 		using lock_type = spinlock;
-		using task_dictionary_type = std::unordered_map<state_base_t*, std::unique_ptr<task_t>>;
 
-#if !RESUMEF_DISABLE_MULT_THREAD
-		mutable spinlock _lock_running;
-#endif
-		state_vector _runing_states;
-		state_vector _cached_states;
+		//每个优先级一组就绪队列
+		struct ready_level_t
+		{
+			//就绪队列。其他线程无锁的加入state，只有运行调度器的线程取出state。队列持有state的一个引用计数。
+			ready_queue_type _queue;
+			//运行调度器的线程，在run_one_batch()期间加入的state，不需要经过共享的就绪队列
+			state_base_t* _local_header = nullptr;
+			state_base_t* _local_tailer = nullptr;
+			size_t _local_count = 0;
+			//有就绪的state，却因为更高优先级而没有运行的连续批次数
+			uint32_t _starved = 0;
+
+			bool empty() const noexcept
+			{
+				return _queue.empty() && _local_header == nullptr;
+			}
+		};
+		ready_level_t _ready_levels[static_cast<size_t>(priority::max__)];
+		//低优先级的state连续这么多批次没有运行后，跟高优先级的一起运行，避免饿死
+		static constexpr uint32_t priority_aging_limit = 8;
+		//正在运行的协程唤醒的state，在其让出后紧接着运行
+		state_base_t* _run_next = nullptr;
+		//正在run_batch_()的恢复循环里。只有恢复循环会取出_run_next
+		bool _resuming = false;
+		//连续从_run_next运行的state数量上限，避免互相唤醒的协程饿死就绪队列里的其他state
+		static constexpr size_t run_next_limit = 64;
+		//受限的run_one_batch()提前返回时，本批次剩余的state，下一批次优先运行
+		state_base_t* _batch_rest = nullptr;
+		size_t _batch_rest_count = 0;
 
 #if !RESUMEF_DISABLE_MULT_THREAD
 		mutable spinlock _lock_ready;
 #endif
-		task_dictionary_type _ready_task;
+		//尚未完成的task_t组成的侵入式双向链表，通过state_base_t::_task从根state找到task_t
+		task_t* _ready_task = nullptr;
 
 		timer_mgr_ptr _timer;
+		std::pmr::memory_resource* _frame_resource = nullptr;
+		bool _thread_confined = false;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+		//属于某个scheduler_pool_t时，才会被其他调度器窃取
+		scheduler_pool_t* _pool = nullptr;
+		//空闲的调度器请求从本调度器窃取，由本调度器在下一批次开始时移交
+		std::atomic<scheduler_t*> _steal_request{ nullptr };
+		//上一批次运行的state数量，用于估计繁忙程度
+		std::atomic<size_t> _batch_size{ 0 };
+		//只有运行调度器的线程访问的就绪state(本地链表、_batch_rest、_run_next)的数量。
+		//每一批次结束时发布，其他线程只能通过它来了解这些state
+		std::atomic<size_t> _local_ready{ 0 };
 
-		LIBRF_API task_t* new_task(task_t* task);
+		//可以在任意线程调用，估计就绪的state数量
+		size_t ready_count_() const noexcept;
+		void publish_ready_() noexcept;
+		size_t handoff_states_(state_base_t* list, size_t count, scheduler_t* thief);
+
+		//run()/run_for()没有就绪的state时，停靠在条件变量上，等待其他线程唤醒
+		std::mutex _park_mtx;
+		std::condition_variable _park_cv;
+		std::atomic<bool> _parked{ false };
+		bool _park_notified = false;
+
+		void notify_parked_() noexcept;
+#endif
+		//要求run()/run_for()返回
+		std::atomic<bool> _run_stopped{ false };
+
+		LIBRF_API void run_until_(std::chrono::steady_clock::time_point end_tp);
+		bool park_until_(std::chrono::steady_clock::time_point end_tp);
+
+		LIBRF_API task_t* new_task(task_t* task, priority pri);
+		LIBRF_API bool run_batch_(size_t max_resumes, std::chrono::steady_clock::time_point end_tp);
+		void push_local_(state_base_t* sptr) noexcept;
+		state_base_t* take_ready_(size_t& count) noexcept;
+		bool ready_empty_() const noexcept;
+		void link_task_(task_t* task) noexcept;
+		void unlink_task_(task_t* task) noexcept;
 		//void cancel_all_task_();
 	public:
 		/**
@@ -43,12 +105,69 @@ namespace librf
 		 */
 		LIBRF_API bool run_one_batch();
 
+		/**
+		 * @brief 运行一批准备妥当的协程，但最多恢复max_resumes个state。
+		 * @details 达到上限后立即返回，本批次剩余的state保留在调度器里，下一次运行时优先运行。\n
+		 * 用于在同一个线程里交替的处理IO和运行协程，控制每次运行协程造成的停顿。
+		 * @param max_resumes 最多恢复的state数量，必须大于0。
+		 * @retval bool 运行了至少一个state，返回true。
+		 */
+		LIBRF_API bool run_one_batch(size_t max_resumes);
+
+		/**
+		 * @brief 运行一批准备妥当的协程，但最多运行dt时长。
+		 * @details 每恢复一个state后检查是否超时，超时则返回，本批次剩余的state保留在调度器里。\n
+		 * 正在运行的协程不会被打断，故实际的停顿会略长于dt。
+		 * @param dt 最长运行的时长。
+		 * @retval bool 运行了至少一个state，返回true。
+		 */
+		template<class _Rep, class _Period>
+		bool run_one_batch(const std::chrono::duration<_Rep, _Period>& dt)
+		{
+			return run_batch_((std::numeric_limits<size_t>::max)(),
+				std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(dt));
+		}
+
 		/**
 		 * @brief 循环运行所有的协程，直到所有协程都运行完成。
 		 * @details 通常用于测试代码。
 		 */
 		LIBRF_API void run_until_notask();
 
+		/**
+		 * @brief 循环运行协程，直到调用了stop()。
+		 * @details 没有就绪的协程时，调用者线程会停靠下来，不占用CPU。以下情况会唤醒线程：\n
+		 * 1、其他线程通过add_generator()加入了state，例如在其他线程里触发了event_t，或者往调度器里go了新的协程；\n
+		 * 2、定时管理器里最近的一个定时器到期；\n
+		 * 3、其他线程调用了stop()。\n
+		 * 禁用多线程(RESUMEF_DISABLE_MULT_THREAD)时，没有协程和定时器也会返回，因为此后再也没有办法唤醒。
+		 */
+		LIBRF_API void run();
+
+		/**
+		 * @brief 循环运行协程，直到经过了指定的时长，或者调用了stop()。
+		 * @details 空闲时的行为同run()。
+		 * @param dt 最长运行的时长。
+		 */
+		template<class _Rep, class _Period>
+		void run_for(const std::chrono::duration<_Rep, _Period>& dt)
+		{
+			run_until_(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(dt));
+		}
+
+		/**
+		 * @brief 要求run()/run_for()尽快返回，可以在任意线程调用。
+		 * @details 正在运行的协程不会被打断，run()/run_for()在当前批次结束后返回。\n
+		 * 如果调用时没有在运行run()/run_for()，则下一次调用的run()/run_for()会立即返回。
+		 */
+		LIBRF_API void stop();
+
+		/**
+		 * @brief 判断本调度器是否正在当前线程里运行run_one_batch()。
+		 * @details 此时本调度器上的协程之间，可以直接转移执行权(symmetric transfer)，而不必经过就绪队列。
+		 */
+		LIBRF_API bool is_running_in_this_thread() const noexcept;
+
 		//void break_all();
 
 		/**
@@ -67,11 +186,26 @@ namespace librf
 		template<class _Ty>
 		requires(traits::is_callable_v<_Ty> || traits::is_future_v<_Ty> || traits::is_generator_v<_Ty>)
 		task_t* operator + (_Ty&& coro)
+		{
+			return spawn(std::forward<_Ty>(coro), priority::normal);
+		}
+
+		/**
+		 * @brief 以指定的优先级，将一个协程加入到调度器里开始运行。
+		 * @details 协程里co_await的子协程，以及等待event_t/mutex_t/channel_t等产生的state，都继承此优先级。\n
+		 * 调度器总是先运行高优先级的协程。低优先级的协程连续若干批次没有运行后，会跟高优先级的协程一起运行，避免被饿死。
+		 * @param coro 协程对象。future_t<>，generator_t<>，或者一个调用后返回future_t<>/generator_t<>的函数对象。
+		 * @param pri 协程的优先级。
+		 * @retval task_t* 返回代表一个新协程的协程任务类。
+		 */
+		template<class _Ty>
+		requires(traits::is_callable_v<_Ty> || traits::is_future_v<_Ty> || traits::is_generator_v<_Ty>)
+		task_t* spawn(_Ty&& coro, priority pri = priority::normal)
 		{
 			if constexpr (traits::is_callable_v<_Ty>)
-				return new_task(new task_ctx_impl_t<_Ty>(coro));
+				return new_task(new task_ctx_impl_t<_Ty>(coro), pri);
 			else
-				return new_task(new task_impl_t<_Ty>(coro));
+				return new_task(new task_impl_t<_Ty>(coro), pri);
 		}
 
 		/**
@@ -79,14 +213,17 @@ namespace librf
 		 * @retval bool 以下条件全部满足，返回true：\n
 		 * 1、所有协程运行完毕\n
 		 * 2、没有正在准备执行的state\n
-		 * 3、定时管理器的empty()返回true。
+		 * 3、定时管理器的empty()返回true。\n
+		 * 可以在任意线程调用。只在运行调度器的线程里访问的就绪state，反映的是上一批次结束时的状态。
 		 */
 		bool empty() const
 		{
 #if !RESUMEF_DISABLE_MULT_THREAD
-			scoped_lock<spinlock, spinlock> __guard(_lock_ready, _lock_running);
+			scoped_lock<spinlock> __guard(_lock_ready);
+			return _ready_task == nullptr && ready_count_() == 0 && _timer->empty();
+#else
+			return _ready_task == nullptr && ready_empty_() && _timer->empty();
 #endif
-			return _ready_task.empty() && _runing_states.empty() && _timer->empty();
 		}
 
 		/**
@@ -97,14 +234,65 @@ namespace librf
 			return _timer.get();
 		}
 
+		/**
+		 * @brief 设置协程帧默认使用的内存资源。
+		 * @details 在本调度器的run_one_batch()里，或者在当前调度器为本调度器的线程里创建的协程，其协程帧从res分配。
+		 * 协程的第一个参数为std::allocator_arg时，则使用参数指定的分配器。\n
+		 * 协程帧可能在其他线程里释放，例如协程被scheduler_pool_t窃取，res需要能在这些线程里使用。
+		 * res必须比从它分配的所有协程帧活得更久。
+		 * @param res 内存资源。为nullptr时，使用线程缓存内存池。
+		 */
+		void set_frame_resource(std::pmr::memory_resource* res) noexcept
+		{
+			_frame_resource = res;
+		}
+
+		/**
+		 * @brief 获得协程帧默认使用的内存资源。
+		 */
+		std::pmr::memory_resource* get_frame_resource() const noexcept
+		{
+			return _frame_resource;
+		}
+
+		/**
+		 * @brief 声明本调度器是线程独占的。
+		 * @details 此后在本调度器的run_one_batch()里，或者在当前调度器为本调度器的线程里创建的state，
+		 * 其引用计数使用普通的读写，而不是原子的读-改-写操作。\n
+		 * 调用者需要保证这些state只在本调度器的线程里访问：协程不能通过via()切换到其他调度器，
+		 * 也不能在其他线程里设置在本线程里创建的awaitable_t的结果。
+		 * 等待event_t/mutex_t/channel_t/select/when_all/when_any的state，由于唤醒者可能在其他线程里，引用计数总是使用原子操作。\n
+		 * 定义了_DEBUG时，会断言线程独占的state只在创建它的线程里加锁和解锁。
+		 * 属于scheduler_pool_t的调度器，由于协程会被窃取，不能声明为线程独占。\n
+		 * 只影响之后创建的state，应当在创建协程之前设置。禁用多线程(RESUMEF_DISABLE_MULT_THREAD)时，引用计数总是普通的整数，本设置没有作用。
+		 */
+		void set_thread_confined(bool confined) noexcept
+		{
+#if !RESUMEF_DISABLE_MULT_THREAD
+			assert(!confined || _pool == nullptr);
+#endif
+			_thread_confined = confined;
+		}
+
+		/**
+		 * @brief 判断本调度器是否被声明为线程独占的。
+		 */
+		bool is_thread_confined() const noexcept
+		{
+			return _thread_confined;
+		}
+
 #ifndef DOXYGEN_SKIP_PROPERTY
-		void add_generator(state_base_t* sptr);
+		LIBRF_API void add_generator(state_base_t* sptr);
+		LIBRF_API void add_run_next(state_base_t* sptr);
 		void del_final(state_base_t* sptr);
 		LIBRF_API std::unique_ptr<task_t> del_switch(state_base_t* sptr);
 		void add_switch(std::unique_ptr<task_t> task);
 		task_t* find_task(state_base_t* sptr) const noexcept;
 
 		friend struct local_scheduler_t;
+		friend struct scheduler_pool_t;
+		friend struct timer_manager;
 	protected:
 		LIBRF_API scheduler_t();
 	public:
@@ -151,32 +339,81 @@ namespace librf
 		scheduler_t* _scheduler_ptr;
 	};
 
-	inline void scheduler_t::add_generator(state_base_t* sptr)
+	inline void scheduler_t::push_local_(state_base_t* sptr) noexcept
 	{
-		assert(sptr != nullptr);
+		ready_level_t& level = _ready_levels[static_cast<size_t>(sptr->get_priority())];
 
-#if !RESUMEF_DISABLE_MULT_THREAD
-		scoped_lock<spinlock> __guard(_lock_running);
-#endif
-		_runing_states.emplace_back(sptr);
+		if (level._local_tailer != nullptr)
+			ready_queue_type::set_next(level._local_tailer, sptr);
+		else
+			level._local_header = sptr;
+		level._local_tailer = sptr;
+		++level._local_count;
+	}
+
+	inline bool scheduler_t::ready_empty_() const noexcept
+	{
+		if (_batch_rest != nullptr || _run_next != nullptr)
+			return false;
+		for (const ready_level_t& level : _ready_levels)
+		{
+			if (!level.empty())
+				return false;
+		}
+		return true;
+	}
+
+	inline void scheduler_t::link_task_(task_t* task) noexcept
+	{
+		assert(task->_prev_task == nullptr && task->_next_task == nullptr);
+
+		task->_state->_task.store(task, std::memory_order_relaxed);
+		task->_next_task = _ready_task;
+		if (_ready_task != nullptr)
+			_ready_task->_prev_task = task;
+		_ready_task = task;
+	}
+
+	inline void scheduler_t::unlink_task_(task_t* task) noexcept
+	{
+		task->_state->_task.store(nullptr, std::memory_order_relaxed);
+		if (task->_prev_task != nullptr)
+			task->_prev_task->_next_task = task->_next_task;
+		else
+			_ready_task = task->_next_task;
+		if (task->_next_task != nullptr)
+			task->_next_task->_prev_task = task->_prev_task;
+		task->_prev_task = nullptr;
+		task->_next_task = nullptr;
 	}
 
 	inline void scheduler_t::del_final(state_base_t* sptr)
 	{
+		//只有根state才会关联task_t，其他state不需要加锁
+		if (sptr->_task.load(std::memory_order_relaxed) == nullptr)
+			return;
+
+		task_t* task;
+		{
 #if !RESUMEF_DISABLE_MULT_THREAD
-		scoped_lock<spinlock> __guard(_lock_ready);
+			scoped_lock<spinlock> __guard(_lock_ready);
 #endif
-		this->_ready_task.erase(sptr);
+			task = sptr->_task.load(std::memory_order_relaxed);
+			if (task == nullptr)
+				return;
+			unlink_task_(task);
+		}
+
+		//销毁task_t会释放state的引用计数，不能在锁内进行
+		delete task;
 	}
 
 	inline void scheduler_t::add_switch(std::unique_ptr<task_t> task)
 	{
-		state_base_t* sptr = task->_state.get();
-
 #if !RESUMEF_DISABLE_MULT_THREAD
 		scoped_lock<spinlock> __guard(_lock_ready);
 #endif
-		this->_ready_task.emplace(sptr, std::move(task));
+		link_task_(task.release());
 	}
 
 	inline task_t* scheduler_t::find_task(state_base_t* sptr) const noexcept
@@ -184,10 +421,33 @@ namespace librf
 #if !RESUMEF_DISABLE_MULT_THREAD
 		scoped_lock<spinlock> __guard(_lock_ready);
 #endif
+		return sptr->_task.load(std::memory_order_relaxed);
+	}
 
-		auto iter = this->_ready_task.find(sptr);
-		if (iter != this->_ready_task.end())
-			return iter->second.get();
-		return nullptr;
+#if !RESUMEF_DISABLE_MULT_THREAD
+	inline size_t scheduler_t::ready_count_() const noexcept
+	{
+		//不能读取只有运行调度器的线程访问的成员，只看发布的数量和共享的就绪队列
+		size_t local = _local_ready.load(std::memory_order_acquire);
+		if (local == 0)
+		{
+			bool shared_empty = true;
+			for (const ready_level_t& level : _ready_levels)
+				shared_empty = shared_empty && level._queue.empty();
+			if (shared_empty)
+				return 0;
+		}
+
+		//无锁队列不维护长度，以上一批次运行的数量来估计
+		return (std::max)(local, _batch_size.load(std::memory_order_relaxed));
 	}
+
+	inline void scheduler_t::publish_ready_() noexcept
+	{
+		size_t local = _batch_rest_count + (_run_next != nullptr ? 1 : 0);
+		for (const ready_level_t& level : _ready_levels)
+			local += level._local_count;
+		_local_ready.store(local, std::memory_order_release);
+	}
+#endif
 }
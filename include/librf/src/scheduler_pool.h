@@ -0,0 +1,130 @@
+﻿#pragma once
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+
+namespace librf
+{
+	/**
+	 * @brief 多线程协程调度器池。
+	 * @details 拥有N个工作线程，每个工作线程绑定一个独立的调度器，并运行这个调度器。\n
+	 * 空闲的工作线程，会从最繁忙的调度器上窃取一半的就绪协程到自己的调度器上运行。
+	 * 仍然找不到事情做时，停靠在调度器上，由新加入的协程、到期的定时器，或者其他有可窃取协程的调度器唤醒。\n
+	 * 窃取由繁忙的调度器在下一批次开始时主动移交，故正在运行的协程不会被打断。\n
+	 * 通过 co_await via(sch) 指定了调度器的协程，会固定在指定的调度器上运行，不会被窃取。\n
+	 * 等待event_t/mutex_t/channel_t唤醒的协程，总是在原调度器上恢复运行。
+	 */
+	struct scheduler_pool_t
+	{
+		/**
+		 * @brief 创建调度器池，并启动工作线程。
+		 * @param thread_count 工作线程的数量。为0时，使用std::thread::hardware_concurrency()。
+		 */
+		LIBRF_API explicit scheduler_pool_t(size_t thread_count = 0);
+
+		/**
+		 * @brief 停止所有工作线程，并销毁调度器。
+		 * @details 尚未运行完成的协程，不会再被运行。
+		 */
+		LIBRF_API ~scheduler_pool_t();
+
+		/**
+		 * @brief 将一个协程加入到调度器池里开始运行。
+		 * @details 轮流选择一个调度器来启动协程。\n
+		 * 在池里的协程中，使用go/GO启动的新协程，会加入到当前工作线程的调度器。
+		 * @param coro 协程对象。future_t<>，generator_t<>，或者一个调用后返回future_t<>/generator_t<>的函数对象。
+		 * @retval task_t* 返回代表一个新协程的协程任务类。
+		 */
+		template<class _Ty>
+		requires(traits::is_callable_v<_Ty> || traits::is_future_v<_Ty> || traits::is_generator_v<_Ty>)
+		task_t* operator + (_Ty&& coro)
+		{
+			scheduler_t* sch = next_scheduler();
+			return *sch + std::forward<_Ty>(coro);
+		}
+
+		/**
+		 * @brief 以指定的优先级，将一个协程加入到调度器池里开始运行。
+		 * @see scheduler_t::spawn()
+		 */
+		template<class _Ty>
+		requires(traits::is_callable_v<_Ty> || traits::is_future_v<_Ty> || traits::is_generator_v<_Ty>)
+		task_t* spawn(_Ty&& coro, priority pri = priority::normal)
+		{
+			scheduler_t* sch = next_scheduler();
+			return sch->spawn(std::forward<_Ty>(coro), pri);
+		}
+
+		/**
+		 * @brief 工作线程(调度器)的数量。
+		 */
+		size_t size() const noexcept
+		{
+			return _schedulers.size();
+		}
+
+		/**
+		 * @brief 获得第idx个工作线程上的调度器。
+		 * @details 可以配合via()使用，将协程固定到某个工作线程上运行。
+		 */
+		scheduler_t* get_scheduler(size_t idx) const noexcept
+		{
+			assert(idx < _schedulers.size());
+			return _schedulers[idx].get();
+		}
+
+		/**
+		 * @brief 按轮流的次序选择一个调度器。
+		 */
+		scheduler_t* next_scheduler() noexcept
+		{
+			size_t idx = _next.fetch_add(1, std::memory_order_relaxed);
+			return _schedulers[idx % _schedulers.size()].get();
+		}
+
+		/**
+		 * @brief 判断池里的所有协程是否运行完毕。
+		 * @see scheduler_t::empty()
+		 */
+		LIBRF_API bool empty() const;
+
+		/**
+		 * @brief 阻塞调用者线程，直到池里所有的协程运行完毕。
+		 * @details 调用者线程不参与协程的运行。每当有工作线程空闲下来时，才重新检查一次。
+		 */
+		LIBRF_API void wait_until_notask() const;
+
+		/**
+		 * @brief 停止所有工作线程。
+		 * @details 工作线程完成当前批次后退出。此后池里的协程不会再被运行。
+		 */
+		LIBRF_API void stop();
+
+		scheduler_pool_t(const scheduler_pool_t&) = delete;
+		scheduler_pool_t& operator = (const scheduler_pool_t&) = delete;
+	private:
+		friend scheduler_t;
+
+		std::vector<std::unique_ptr<scheduler_t>> _schedulers;
+		std::vector<std::thread> _threads;
+		std::atomic<size_t> _next{ 0 };
+		std::atomic<bool> _stop{ false };
+		//移交state期间，task可能暂时不在任何一个调度器里，empty()据此判断结果是否可信
+		std::atomic<intptr_t> _steal_begin{ 0 };
+		std::atomic<intptr_t> _steal_end{ 0 };
+
+		//准备停靠或者已经停靠的工作线程数量
+		std::atomic<size_t> _idle_count{ 0 };
+		//wait_until_notask()在工作线程空闲下来时被唤醒
+		mutable std::mutex _idle_mtx;
+		mutable std::condition_variable _idle_cv;
+		mutable std::atomic<size_t> _idle_waiters{ 0 };
+
+		void run_worker_(size_t idx);
+		bool request_steal_(size_t idx);
+		void park_worker_(size_t idx);
+		void wake_idle_(scheduler_t* busy) noexcept;
+		void notify_idle_() noexcept;
+	};
+}
+
+#endif	//!RESUMEF_DISABLE_MULT_THREAD
@@ -10,21 +10,24 @@ namespace librf
 	 * @brief 协程专用的睡眠功能。
 	 * @details 不能使用操作系统提供的sleep功能，因为会阻塞协程。\n
 	 * 此函数不会阻塞线程，仅仅将当前协程挂起，直到指定时刻。\n
-	 * 其精度，取决与调度器循环的精度，以及std::chrono::system_clock的精度。简而言之，可以认为只要循环够快，精度到100ns。
+	 * 其精度，取决与调度器循环的精度，以及定时器时钟的精度。简而言之，可以认为只要循环够快，精度到100ns。
+	 * 通过timer_manager::set_backend()切换到时间轮后，精度为timer_manager::wheel_tick。\n
+	 * 定时器使用单调时钟，不受系统时间调整的影响。
 	 * @return [co_await] void
 	 * @throw timer_canceled_exception 如果定时器被取消，则抛此异常。
 	 */
-	LIBRF_API future_t<> sleep_until_(std::chrono::system_clock::time_point tp_, scheduler_t& scheduler_);
+	LIBRF_API future_t<> sleep_until_(timer_manager::time_point_type tp_, scheduler_t& scheduler_);
 
 	/**
 	 * @brief 协程专用的睡眠功能。
+	 * @details 在调度器的批次里调用时，从批次开始算起，参见timer_manager::now()。
 	 * @see 参考sleep_until_()函数\n
 	 * @return [co_await] void
 	 * @throw timer_canceled_exception 如果定时器被取消，则抛此异常。
 	 */
-	inline future_t<> sleep_for_(std::chrono::system_clock::duration dt_, scheduler_t& scheduler_)
+	inline future_t<> sleep_for_(timer_manager::duration_type dt_, scheduler_t& scheduler_)
 	{
-		return sleep_until_(std::chrono::system_clock::now() + dt_, scheduler_);
+		return sleep_until_(scheduler_.timer()->now() + dt_, scheduler_);
 	}
 
 	/**
@@ -36,7 +39,7 @@ namespace librf
 	template<class _Rep, class _Period>
 	inline future_t<> sleep_for(std::chrono::duration<_Rep, _Period> dt_, scheduler_t& scheduler_)
 	{
-		return sleep_for_(std::chrono::duration_cast<std::chrono::system_clock::duration>(dt_), scheduler_);
+		return sleep_for_(std::chrono::duration_cast<timer_manager::duration_type>(dt_), scheduler_);
 	}
 
 	/**
@@ -48,7 +51,7 @@ namespace librf
 	template<class _Clock, class _Duration = typename _Clock::duration>
 	inline future_t<> sleep_until(std::chrono::time_point<_Clock, _Duration> tp_, scheduler_t& scheduler_)
 	{
-		return sleep_until_(std::chrono::time_point_cast<std::chrono::system_clock::duration>(tp_), scheduler_);
+		return sleep_until_(timer_manager::to_time_point(tp_), scheduler_);
 	}
 
 	/**
@@ -61,7 +64,7 @@ namespace librf
 	inline future_t<> sleep_for(std::chrono::duration<_Rep, _Period> dt_)
 	{
 		scheduler_t* sch = librf_current_scheduler();
-		co_await sleep_for_(std::chrono::duration_cast<std::chrono::system_clock::duration>(dt_), *sch);
+		co_await sleep_for_(std::chrono::duration_cast<timer_manager::duration_type>(dt_), *sch);
 	}
 
 	/**
@@ -74,7 +77,7 @@ namespace librf
 	inline future_t<> sleep_until(std::chrono::time_point<_Clock, _Duration> tp_)
 	{
 		scheduler_t* sch = librf_current_scheduler();
-		co_await sleep_until_(std::chrono::time_point_cast<std::chrono::system_clock::duration>(tp_), *sch);
+		co_await sleep_until_(timer_manager::to_time_point(tp_), *sch);
 	}
 
 	/**
@@ -4,26 +4,85 @@ namespace librf
 {
 	/**
 	 * @brief state基类，state用于在协程的promise和future之间共享数据。
+	 * @details 通过intrusive_mpsc_node链接到调度器的就绪队列里。
 	 */
-	struct state_base_t
+	struct state_base_t : public intrusive_mpsc_node<state_base_t>
 	{
-		using _Alloc_char = std::allocator<char>;
+		using _Alloc_char = detail::pool_allocator<char>;
 	private:
-		std::atomic<intptr_t> _count{0};
+#if RESUMEF_DISABLE_MULT_THREAD
+		int32_t _count = 0;
+#else
+		std::atomic<int32_t> _count{0};
+#endif
+	protected:
+		//从根state继承来的优先级，决定进入调度器的哪一个就绪队列
+		priority _priority = priority::normal;
+	private:
+#if !RESUMEF_DISABLE_MULT_THREAD
+		//在线程独占的调度器上创建的state，只会被这一个线程访问，引用计数不需要原子的读-改-写操作
+		bool _confined = detail::current_thread_confined();
+#if _DEBUG
+		std::thread::id _confined_thread = std::this_thread::get_id();
+#endif
+#endif
 	public:
 		void lock() noexcept
 		{
-			_count.fetch_add(1, std::memory_order_acq_rel);
+#if RESUMEF_DISABLE_MULT_THREAD
+			++_count;
+#else
+			assert_confined_thread_();
+			if (_confined)
+				_count.store(_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			else
+				_count.fetch_add(1, std::memory_order_acq_rel);
+#endif
 		}
 		void unlock()
 		{
-			if (unlikely(_count.fetch_sub(1, std::memory_order_acq_rel) == 1))
+#if RESUMEF_DISABLE_MULT_THREAD
+			if (unlikely(--_count == 0))
+#else
+			assert_confined_thread_();
+			int32_t count;
+			if (_confined)
+			{
+				count = _count.load(std::memory_order_relaxed);
+				_count.store(count - 1, std::memory_order_relaxed);
+			}
+			else
+			{
+				count = _count.fetch_sub(1, std::memory_order_acq_rel);
+			}
+			if (unlikely(count == 1))
+#endif
 			{
 				destroy_deallocate();
 			}
 		}
+	private:
+		void assert_confined_thread_() const noexcept
+		{
+#if !RESUMEF_DISABLE_MULT_THREAD && _DEBUG
+			assert(!_confined || _confined_thread == std::this_thread::get_id());
+#endif
+		}
 	protected:
+		friend scheduler_t;
+
+		//等待event_t/mutex_t/channel_t等对象的state，会在唤醒者的线程里加锁和解锁，必须在构造函数里调用，使引用计数总是使用原子操作
+		void disable_confined() noexcept
+		{
+#if !RESUMEF_DISABLE_MULT_THREAD
+			_confined = false;
+#endif
+		}
+
 		scheduler_t* _scheduler = nullptr;
+		//由调度器启动的协程，其根state指向对应的task_t。在调度器的_lock_ready保护下修改。
+		//del_final()等会在锁外先读取一次，以免非根state也要加锁，故使用原子变量
+		std::atomic<task_t*> _task{ nullptr };
 		//可能来自协程里的promise产生的，则经过co_await操作后，_coro在初始时不会为nullptr。
 		//也可能来自awaitable_t，如果
 		//		一、经过co_await操作后，_coro在初始时不会为nullptr。
@@ -37,11 +96,20 @@ namespace librf
 		LIBRF_API virtual void resume();
 		LIBRF_API virtual bool has_handler() const  noexcept;
 		LIBRF_API virtual state_base_t* get_parent() const noexcept;
+		LIBRF_API virtual bool try_migrate(scheduler_t* sch);
 
 		void set_scheduler(scheduler_t* sch) noexcept
 		{
 			_scheduler = sch;
 		}
+		priority get_priority() const noexcept
+		{
+			return _priority;
+		}
+		void set_priority(priority pri) noexcept
+		{
+			_priority = pri;
+		}
 		coroutine_handle<> get_handler() const noexcept
 		{
 			return _coro;
@@ -75,6 +143,7 @@ namespace librf
 	public:
 		LIBRF_API virtual void resume() override;
 		LIBRF_API virtual bool has_handler() const  noexcept override;
+		LIBRF_API virtual bool try_migrate(scheduler_t* sch) override;
 
 		LIBRF_API bool switch_scheduler_await_suspend(scheduler_t* sch);
 
@@ -113,11 +182,15 @@ namespace librf
 #if RESUMEF_DEBUG_COUNTER
 		intptr_t _id;
 #endif
+		//最高位为alloc_in_frame时，state与协程帧分配在一起，_alloc_size是两者合计的大小
 		uint32_t _alloc_size = 0;
+		static constexpr uint32_t alloc_in_frame = 0x80000000u;
 		//注意：_has_value对齐到 4 Byte上，后面必须紧跟 _is_future变量。两者能组合成一个uint16_t数据。
 		std::atomic<result_type> _has_value{ result_type::None };
 		bool _is_future;
 		initor_type _is_initor = initor_type::None;
+		//根state上的标记：协程通过via()指定过调度器，则不能被scheduler_pool_t窃取到其他调度器上运行。
+		bool _is_pinned = false;
 		static_assert(sizeof(std::atomic<result_type>) == 1);
 		static_assert(alignof(std::atomic<result_type>) == 1);
 		static_assert(sizeof(bool) == 1);
@@ -137,6 +210,7 @@ namespace librf
 		LIBRF_API virtual void resume() override;
 		LIBRF_API virtual bool has_handler() const  noexcept override;
 		LIBRF_API virtual state_base_t* get_parent() const noexcept override;
+		LIBRF_API virtual bool try_migrate(scheduler_t* sch) override;
 
 		inline bool is_ready() const noexcept
 		{
@@ -160,7 +234,15 @@ namespace librf
 
 		inline uint32_t get_alloc_size() const noexcept
 		{
-			return _alloc_size;
+			return _alloc_size & ~alloc_in_frame;
+		}
+
+		/**
+		 * @brief state是否与协程帧分配在同一块内存里。
+		 */
+		inline bool is_in_frame() const noexcept
+		{
+			return (_alloc_size & alloc_in_frame) != 0;
 		}
 
 		inline bool future_await_ready() const noexcept
@@ -169,15 +251,97 @@ namespace librf
 			return _has_value.load(std::memory_order_acquire) != result_type::None;
 		}
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
-		void future_await_suspend(coroutine_handle<_PromiseT> handler);
+		coroutine_handle<> future_await_suspend(coroutine_handle<_PromiseT> handler);
 
 		LIBRF_API bool switch_scheduler_await_suspend(scheduler_t* sch);
 
+		//正在运行的协程让出时，将自身的state加入调度器的就绪队列，由resume()从_initor处继续运行。不需要另外分配state
+		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
+		void yield_await_suspend(coroutine_handle<_PromiseT> handler);
+
+		//协程结束后直接转移到了等待者，则协程停在final_suspend处，由等待者在恢复时及时销毁，不必等到调度器下一次resume()
+		void future_await_finalize()
+		{
+			std::unique_lock<lock_type> __guard(_mtx);
+			if (_is_initor != initor_type::Final)
+				return;
+
+			coroutine_handle<> handler = _initor;
+			_is_initor = initor_type::None;
+			__guard.unlock();
+
+			handler.destroy();
+		}
+
+		void pin_root() noexcept
+		{
+			state_future_t* root = this;
+			while (root->_parent != nullptr)
+				root = root->_parent;
+			root->_is_pinned = true;
+		}
+
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
 		void promise_initial_suspend(coroutine_handle<_PromiseT> handler);
 
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
-		void promise_final_suspend(coroutine_handle<_PromiseT> handler);
+		coroutine_handle<> promise_final_suspend(coroutine_handle<_PromiseT> handler);
+
+#if !RESUMEF_DISABLE_STATE_IN_FRAME
+		/*
+		协程帧与state分配在同一块内存里：[state][协程帧]。
+		operator new构造state，并替协程帧持有一个引用，在operator delete里释放。这块内存在state的引用计数归零时才释放，
+		故协程帧销毁后，future_t仍然可以访问state。
+		operator new通过线程局部变量将state交给随后构造的promise。协程帧的分配被编译器优化掉，
+		或者中间插入了其他协程的分配，导致类型对不上时，promise退回到单独分配state。
+		*/
+		template<class _Sty>
+		static constexpr size_t _Frame_state_size() noexcept
+		{
+			return (sizeof(_Sty) + __STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1) & ~(__STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1);
+		}
+
+		template<class _Sty>
+		static void* _Construct_frame_state(void* ptr, size_t total_size) noexcept
+		{
+			_Sty* st = new(ptr) _Sty(false);
+			st->_alloc_size = static_cast<uint32_t>(total_size) | alloc_in_frame;
+			st->lock();
+
+			_frame_state = st;
+			_frame_state_tag = &_frame_state_tag_v<_Sty>;
+
+			return static_cast<char*>(ptr) + _Frame_state_size<_Sty>();
+		}
+
+		template<class _Sty>
+		static void _Release_frame_state(void* frame) noexcept
+		{
+			_Sty* st = std::launder(reinterpret_cast<_Sty*>(static_cast<char*>(frame) - _Frame_state_size<_Sty>()));
+			if (_frame_state == st)
+				_frame_state = nullptr;
+			st->unlock();
+		}
+
+		template<class _Sty>
+		static _Sty* _Take_frame_state(bool awaitor)
+		{
+			state_future_t* st = _frame_state;
+			if (likely(st != nullptr && _frame_state_tag == &_frame_state_tag_v<_Sty>))
+			{
+				_frame_state = nullptr;
+				return static_cast<_Sty*>(st);
+			}
+			return _Alloc_state<_Sty>(awaitor);
+		}
+	private:
+		template<class _Sty>
+		static constexpr char _frame_state_tag_v = 0;
+
+		static inline thread_local state_future_t* _frame_state = nullptr;
+		static inline thread_local const void* _frame_state_tag = nullptr;
+	public:
+#endif	//!RESUMEF_DISABLE_STATE_IN_FRAME
 
 		template<class _Sty>
 		static inline _Sty* _Alloc_state(bool awaitor)
@@ -232,6 +396,11 @@ namespace librf
 		template<typename U>
 		void set_value(U&& val);
 
+		//由promise在协程结束时调用，只设置结果。等待者由随后的promise_final_suspend()调度
+		template<typename U>
+		void promise_return_value(U&& val);
+		void promise_unhandled_exception(std::exception_ptr e);
+
 		template<class _Exp>
 		inline void throw_exception(_Exp e)
 		{
@@ -275,6 +444,9 @@ namespace librf
 		void set_exception(std::exception_ptr e);
 		void set_value(reference_type val);
 
+		void promise_return_value(reference_type val);
+		void promise_unhandled_exception(std::exception_ptr e);
+
 		template<class _Exp>
 		inline void throw_exception(_Exp e)
 		{
@@ -307,6 +479,9 @@ namespace librf
 		LIBRF_API void set_exception(std::exception_ptr e);
 		LIBRF_API void set_value();
 
+		LIBRF_API void promise_return_value();
+		LIBRF_API void promise_unhandled_exception(std::exception_ptr e);
+
 		template<class _Exp>
 		inline void throw_exception(_Exp e)
 		{
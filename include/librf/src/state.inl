@@ -12,7 +12,7 @@ namespace librf
 	}
 
 	template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
-	void state_future_t::promise_final_suspend(coroutine_handle<_PromiseT> handler)
+	coroutine_handle<> state_future_t::promise_final_suspend(coroutine_handle<_PromiseT> handler)
 	{
 		scoped_lock<lock_type> __guard(this->_mtx);
 
@@ -22,13 +22,23 @@ namespace librf
 		scheduler_t* sch = this->get_scheduler();
 		assert(sch != nullptr);
 
+		coroutine_handle<> continuation = noop_coroutine();
 		if (this->has_handler_skip_lock())
-			sch->add_generator(this);
+		{
+			//等待者的调度器正在本线程运行，则直接转移到等待者，省去一次调度。
+			//此时本协程停在final_suspend处，由等待者在future_t::await_resume()里销毁。
+			if (this->_coro && this->_coro != handler && sch->is_running_in_this_thread())
+				continuation = std::exchange(this->_coro, nullptr);
+			else
+				sch->add_generator(this);
+		}
 		sch->del_final(this);
+
+		return continuation;
 	}
 
 	template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
-	void state_future_t::future_await_suspend(coroutine_handle<_PromiseT> handler)
+	coroutine_handle<> state_future_t::future_await_suspend(coroutine_handle<_PromiseT> handler)
 	{
 		_PromiseT& promise = handler.promise();
 		auto* parent_state = promise.get_state();
@@ -40,13 +50,43 @@ namespace librf
 		{
 			this->_parent = parent_state;
 			this->_scheduler = sch;
+			this->_priority = parent_state->get_priority();
 		}
 
 		if (!this->_coro)
 			this->_coro = handler;
 
 		if (sch != nullptr && this->is_ready())
+		{
+			//尚未开始运行的子协程，且调度器正在本线程运行，则直接转移到子协程开始运行，省去一次调度。
+			//通过go启动过的协程(_task不为空)，可能已经在就绪队列里了，仍然交给调度器。
+			if (this->_is_initor == initor_type::Initial && this->_task.load(std::memory_order_relaxed) == nullptr && sch->is_running_in_this_thread())
+			{
+				this->_is_initor = initor_type::None;
+				return this->_initor;
+			}
 			sch->add_generator(this);
+		}
+
+		return noop_coroutine();
+	}
+
+	template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
+	void state_future_t::yield_await_suspend(coroutine_handle<_PromiseT> handler)
+	{
+		scheduler_t* sch;
+		{
+			scoped_lock<lock_type> __guard(this->_mtx);
+			assert(this->_is_initor == initor_type::None);
+
+			this->_initor = handler;
+			this->_is_initor = initor_type::Initial;
+			sch = this->get_scheduler();
+		}
+		assert(sch != nullptr);
+
+		//加入就绪队列后，协程可能立即在其他线程恢复运行，此后不能再访问协程帧
+		sch->add_generator(this);
 	}
 
 	//------------------------------------------------------------------------------------------------
@@ -188,6 +228,21 @@ namespace librf
 		}
 	}
 
+	template<typename _Ty>
+	template<typename U>
+	void state_t<_Ty>::promise_return_value(U&& val)
+	{
+		scoped_lock<lock_type> __guard(this->_mtx);
+		set_value_internal(std::forward<U>(val));
+	}
+
+	template<typename _Ty>
+	void state_t<_Ty>::promise_unhandled_exception(std::exception_ptr e)
+	{
+		scoped_lock<lock_type> __guard(this->_mtx);
+		set_exception_internal(std::move(e));
+	}
+
 	//------------------------------------------------------------------------------------------------
 
 	template<typename _Ty>
@@ -294,5 +349,19 @@ namespace librf
 				sch->del_final(this);
 		}
 	}
+
+	template<typename _Ty>
+	void state_t<_Ty&>::promise_return_value(reference_type val)
+	{
+		scoped_lock<lock_type> __guard(this->_mtx);
+		set_value_internal(val);
+	}
+
+	template<typename _Ty>
+	void state_t<_Ty&>::promise_unhandled_exception(std::exception_ptr e)
+	{
+		scoped_lock<lock_type> __guard(this->_mtx);
+		set_exception_internal(std::move(e));
+	}
 }
 
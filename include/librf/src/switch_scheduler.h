@@ -30,12 +30,11 @@ namespace librf
 		{
 			_PromiseT& promise = handler.promise();
 			auto* sptr = promise.get_state();
+			//通过via()指定了调度器的协程，不再被scheduler_pool_t窃取
+			sptr->pin_root();
 			if (sptr->switch_scheduler_await_suspend(_scheduler))
 			{
-				counted_ptr<state_t<void>> _state = state_future_t::_Alloc_state<state_type>(true);
-				_state->set_value();
-				_state->future_await_suspend(handler);
-
+				sptr->yield_await_suspend(handler);
 				return true;
 			}
 			return false;
@@ -85,7 +84,8 @@ namespace librf
 	 * @brief 将本协程切换到指定调度器上运行。
 	 * @details 由于调度器必然在某个线程里运行，故达到了切换到特定线程里运行的目的。\n
 	 * 如果指定的协程就是本协程的调度器，则协程不暂停直接运行接下来的代码。
-	 * 如果指定的协程不是本协程的调度器，则协程暂停后放入到目的协程的调度队列，等待下一次运行。
+	 * 如果指定的协程不是本协程的调度器，则协程暂停后放入到目的协程的调度队列，等待下一次运行。\n
+	 * 使用过via()的协程，将固定在指定的调度器上运行，不会被 scheduler_pool_t 窃取到其他调度器上。
 	 * @param sch 将要运行此后代码的协程
 	 */
 	inline switch_scheduler_awaitor via(scheduler_t& sch) noexcept
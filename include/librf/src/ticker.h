@@ -0,0 +1,148 @@
+﻿//协程的周期定时器
+//
+#pragma once
+
+namespace librf
+{
+#ifndef DOXYGEN_SKIP_PROPERTY
+	namespace detail
+	{
+		struct state_ticker_t : public state_base_t
+		{
+			state_ticker_t(timer_manager::duration_type period_) noexcept
+				: _period(period_)
+			{
+			}
+
+			LIBRF_API bool arm(coroutine_handle<> handler, state_base_t* parent);
+			LIBRF_API size_t take_ticks(const timer_manager::time_point_type& now_) noexcept;
+			LIBRF_API void stop(bool wakeup) noexcept;
+
+			bool is_stopped() const noexcept
+			{
+				return _stopped.load(std::memory_order_acquire);
+			}
+			timer_manager::duration_type period() const noexcept
+			{
+				return _period;
+			}
+			size_t ticks() const noexcept
+			{
+				return _ticks;
+			}
+		private:
+			timer_manager::timer_node _timer;
+			std::atomic<timer_manager*> _manager{ nullptr };
+			timer_manager::time_point_type _next{};		//下一次的计划触发时间，按_period等间隔排列，不随触发的延迟而漂移
+			timer_manager::duration_type _period;
+			size_t _ticks = 0;							//最近一次唤醒时，经过的周期数
+			std::atomic<bool> _stopped{ false };
+
+			void on_timer_(bool canceld);
+		};
+	}
+#endif	//DOXYGEN_SKIP_PROPERTY
+
+	/**
+	 * @brief 周期定时器，以固定的间隔唤醒协程。
+	 * @details 计划触发时间按照第一次co_await的时刻，加上周期的整数倍排列，不会因为协程的处理耗时或者调度的延迟而漂移。\n
+	 * 整个生存期只分配一次state，内嵌一个定时器节点。每次co_await都重用这个节点，不再分配内存。\n
+	 * co_await返回自上一次唤醒以来经过的周期数：正常为1，大于1表示错过了若干次触发；返回0表示已经被stop()。\n
+	 * 协程没能及时co_await，已经错过了计划触发时间时，co_await不会挂起协程，立即返回经过的周期数。\n
+	 * 一个ticker_t同时只能被一个协程等待。
+	 */
+	struct ticker_t
+	{
+		using state_type = detail::state_ticker_t;
+
+		/**
+		 * @brief 构造一个周期定时器。
+		 * @param period_ 周期，必须大于0。
+		 */
+		template<class _Rep, class _Period>
+		explicit ticker_t(std::chrono::duration<_Rep, _Period> period_)
+			: _state(new state_type(std::chrono::duration_cast<timer_manager::duration_type>(period_)))
+		{
+			assert(_state->period() > timer_manager::duration_type::zero());
+		}
+
+		/**
+		 * @brief 析构时停止周期定时器，但不再唤醒协程。
+		 * @details 协程在等待期间被销毁时，ticker_t随之析构，此时必须在协程所在的线程里析构。
+		 */
+		~ticker_t()
+		{
+			if (_state)
+				_state->stop(false);
+		}
+
+		ticker_t(ticker_t&&) noexcept = default;
+		ticker_t& operator = (ticker_t&&) noexcept = default;
+		ticker_t(const ticker_t&) = delete;
+		ticker_t& operator = (const ticker_t&) = delete;
+
+		/**
+		 * @brief 停止周期定时器。可以在任意线程调用。
+		 * @details 正在等待的协程被唤醒，co_await返回0。此后的co_await都立即返回0。
+		 */
+		void stop() noexcept
+		{
+			_state->stop(true);
+		}
+
+		/**
+		 * @brief 获得周期。
+		 */
+		timer_manager::duration_type period() const noexcept
+		{
+			return _state->period();
+		}
+
+#ifndef DOXYGEN_SKIP_PROPERTY
+		struct awaiter
+		{
+			state_type* _state;
+
+			bool await_ready() const noexcept
+			{
+				return _state->is_stopped();
+			}
+			template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
+			bool await_suspend(coroutine_handle<_PromiseT> handler)
+			{
+				return _state->arm(handler, handler.promise().get_state());
+			}
+			size_t await_resume() const noexcept
+			{
+				return _state->is_stopped() ? 0 : _state->ticks();
+			}
+		};
+
+		awaiter operator co_await() noexcept
+		{
+			return { _state.get() };
+		}
+#endif	//DOXYGEN_SKIP_PROPERTY
+	private:
+		counted_ptr<state_type> _state;
+	};
+
+	/**
+	 * @brief 创建一个周期定时器。
+	 * @details 用法：
+	 * @code
+	 * auto ticker = interval(1s);
+	 * for (;;)
+	 * {
+	 *     size_t ticks = co_await ticker;
+	 *     ...
+	 * }
+	 * @endcode
+	 * @see ticker_t
+	 */
+	template<class _Rep, class _Period>
+	inline ticker_t interval(std::chrono::duration<_Rep, _Period> period_)
+	{
+		return ticker_t{ period_ };
+	}
+}
@@ -9,46 +9,225 @@ namespace librf
 
 	namespace detail
 	{
-		typedef std::chrono::system_clock timer_clock_type;
-		typedef std::function<void(bool)> timer_callback_type;
+		//单调时钟，不受系统时间调整的影响
+		typedef std::chrono::steady_clock timer_clock_type;
 
 		/**
-		 * @brief 定时器对象。
+		 * @brief 定时器的回调，参数为true表示定时器被取消。
+		 * @details 不超过inline_size的可调用对象直接保存在内部，不需要分配内存。更大的可调用对象，则分配在堆上。\n
+		 * 只支持移动，不支持拷贝。
 		 */
-		struct timer_target : public std::enable_shared_from_this<timer_target>
+		struct timer_callback
 		{
-			friend timer_manager;
+			static constexpr size_t inline_size = sizeof(void*) * 3;
+
+			timer_callback() noexcept = default;
+			timer_callback(std::nullptr_t) noexcept {}
+
+			template<class _Fx>
+			requires(!std::is_same_v<remove_cvref_t<_Fx>, timer_callback> && std::is_invocable_v<std::decay_t<_Fx>&, bool>)
+			timer_callback(_Fx&& fx)
+			{
+				using functor_type = std::decay_t<_Fx>;
+				if constexpr (is_inline_v<functor_type>)
+				{
+					new(static_cast<void*>(_storage)) functor_type(std::forward<_Fx>(fx));
+					_invoke = [](void* p, bool canceld) { (*static_cast<functor_type*>(p))(canceld); };
+					_manage = [](void* dst, void* src) noexcept
+						{
+							if (src != nullptr)
+							{
+								new(dst) functor_type(std::move(*static_cast<functor_type*>(src)));
+								static_cast<functor_type*>(src)->~functor_type();
+							}
+							else
+							{
+								static_cast<functor_type*>(dst)->~functor_type();
+							}
+						};
+				}
+				else
+				{
+					*reinterpret_cast<functor_type**>(_storage) = new functor_type(std::forward<_Fx>(fx));
+					_invoke = [](void* p, bool canceld) { (**static_cast<functor_type**>(p))(canceld); };
+					_manage = [](void* dst, void* src) noexcept
+						{
+							if (src != nullptr)
+								*static_cast<functor_type**>(dst) = *static_cast<functor_type**>(src);
+							else
+								delete *static_cast<functor_type**>(dst);
+						};
+				}
+			}
+
+			timer_callback(timer_callback&& right_) noexcept
+				: _invoke(std::exchange(right_._invoke, nullptr))
+				, _manage(std::exchange(right_._manage, nullptr))
+			{
+				if (_manage != nullptr)
+					_manage(_storage, right_._storage);
+			}
+
+			timer_callback& operator = (timer_callback&& right_) noexcept
+			{
+				if (this != &right_)
+				{
+					reset();
+					_invoke = std::exchange(right_._invoke, nullptr);
+					_manage = std::exchange(right_._manage, nullptr);
+					if (_manage != nullptr)
+						_manage(_storage, right_._storage);
+				}
+				return *this;
+			}
+
+			~timer_callback()
+			{
+				reset();
+			}
+
+			void reset() noexcept
+			{
+				if (_manage != nullptr)
+				{
+					_manage(_storage, nullptr);
+					_invoke = nullptr;
+					_manage = nullptr;
+				}
+			}
+
+			explicit operator bool() const noexcept
+			{
+				return _invoke != nullptr;
+			}
+
+			void operator()(bool canceld)
+			{
+				assert(_invoke != nullptr);
+				_invoke(_storage, canceld);
+			}
+
+			timer_callback(const timer_callback&) = delete;
+			timer_callback& operator = (const timer_callback&) = delete;
 		private:
-			enum struct State : uint32_t
+			template<class _Fx>
+			static constexpr bool is_inline_v = sizeof(_Fx) <= inline_size
+				&& alignof(_Fx) <= alignof(void*)
+				&& std::is_nothrow_move_constructible_v<_Fx>;
+
+			//src不为空，则从src移动构造到dst，并析构src；否则析构dst
+			using manage_fn = void(*)(void* dst, void* src) noexcept;
+			using invoke_fn = void(*)(void* p, bool canceld);
+
+			alignas(void*) unsigned char _storage[inline_size];
+			invoke_fn _invoke = nullptr;
+			manage_fn _manage = nullptr;
+		};
+
+		typedef timer_callback timer_callback_type;
+
+		/**
+		 * @brief 侵入式的定时器节点。
+		 * @details 定时器管理器只链接节点，不管理节点的生存期，添加和取消定时器都不需要分配内存。\n
+		 * 节点可以内嵌在其他对象里，例如event_t/mutex_t的等待state。添加后，节点必须保持有效，直到回调被调用。\n
+		 * 回调总会被调用一次：到期时参数为false；被取消，或者定时器管理器被清理时，参数为true。\n
+		 * 调用回调之前，管理器已经不再访问节点，故回调里可以销毁节点，也可以重新添加节点。\n
+		 * 被取消的节点，在下一次update()时就从管理器里移除并调用回调，而不是等到原来的到期时间。
+		 */
+		struct timer_node
+		{
+			/**
+			 * @brief slack的默认值，表示使用定时器管理器的slack。
+			 */
+			static constexpr timer_clock_type::duration inherit_slack{ -1 };
+
+			timer_clock_type::time_point	tp;
+			timer_callback_type				cb;
+			/**
+			 * @brief 允许定时器延迟触发的时长。
+			 * @details 大于0时，到期时间会向上对齐到slack的整数倍，使到期时间落在同一个窗口里的定时器在同一个批次里触发。
+
+			 * 为0表示不延迟；为inherit_slack则使用timer_manager::set_slack()设置的值。
+			 */
+			timer_clock_type::duration		slack = inherit_slack;
+
+			timer_node() noexcept = default;
+			template<class _Cb>
+			timer_node(const timer_clock_type::time_point & tp_, _Cb && cb_)
+				: tp(tp_)
+				, cb(std::forward<_Cb>(cb_))
+			{
+			}
+
+			/**
+			 * @brief 节点是否已经添加到定时器管理器里，且回调尚未被调用。
+			 * @details 被stop()的节点，直到update()将其移除并调用回调之前，仍然返回true。此期间不能重新添加或者销毁节点。
+			 */
+			bool is_pending() const noexcept
+			{
+				return st.load(std::memory_order_acquire) != State::Invalid;
+			}
+		private:
+			friend timer_manager;
+
+			enum struct State : uint16_t
 			{
 				Invalid,
 				Added,
 				Runing,
+				Canceled,				//运行中被取消，等待update()将其移除
+				AddCanceled,			//还在待添加链表里就被取消，等待update()将其移出链表
 			};
-			timer_clock_type::time_point	tp;
-			timer_callback_type				cb;
-			State							st = State::Invalid;
+			static constexpr uint16_t slot_none = 0xFFFF;
+			static constexpr uint16_t slot_heap = 0xFFFE;
+
+			std::atomic<State>				st{ State::Invalid };
+			//所在的时间轮的槽；或者slot_heap，表示在堆里；或者slot_none
+			uint16_t						_slot = slot_none;
+			//在待添加链表里的单链表节点，或者在时间轮的槽里的双链表节点。
+			//在堆里时，_next指向右边的兄弟，_prev指向左边的兄弟，第一个子节点的_prev指向父节点
+			timer_node*						_next = nullptr;
+			timer_node*						_prev = nullptr;
+			//在堆里的第一个子节点
+			timer_node*						_child = nullptr;
+			//在已取消链表里的单链表节点
+			timer_node*						_canceled_next = nullptr;
+			//加入堆的序号，到期时间相同的定时器按加入的先后触发
+			uint64_t						_seq = 0;
 #if _DEBUG
-		private:
-			timer_manager *					_manager = nullptr;
+			timer_manager*					_manager = nullptr;
 #endif
-		public:
-			timer_target(const timer_clock_type::time_point & tp_, const timer_callback_type & cb_)
-				: tp(tp_)
-				, cb(cb_)
+
+			timer_node(const timer_node&) = delete;
+			timer_node(timer_node&&) = delete;
+			timer_node& operator = (const timer_node&) = delete;
+			timer_node& operator = (timer_node&&) = delete;
+		};
+
+		/**
+		 * @brief 由shared_ptr管理的定时器对象，用于timer_manager::add()和timer_handler。
+		 * @details 添加后，由定时器管理器持有一个引用，直到回调被调用。
+		 */
+		struct timer_target : public timer_node, public std::enable_shared_from_this<timer_target>
+		{
+			friend timer_manager;
+
+			template<class _Cb>
+			timer_target(const timer_clock_type::time_point & tp_, _Cb && cb_)
+				: timer_node(tp_, [this](bool canceld) { this->on_timer_(canceld); })
+				, _callback(std::forward<_Cb>(cb_))
 			{
 			}
-			timer_target(const timer_clock_type::time_point & tp_, timer_callback_type && cb_)
-				: tp(tp_)
-				, cb(std::forward<timer_callback_type>(cb_))
+		private:
+			timer_callback_type				_callback;
+			std::shared_ptr<timer_target>	_owner;
+
+			void on_timer_(bool canceld)
 			{
+				std::shared_ptr<timer_target> self = std::move(_owner);
+				timer_callback_type cb_ = std::move(_callback);
+				if (cb_) cb_(canceld);
 			}
-		private:
-			timer_target() = delete;
-			timer_target(const timer_target &) = delete;
-			timer_target(timer_target && right_) = delete;
-			timer_target & operator = (const timer_target &) = delete;
-			timer_target & operator = (timer_target && right_) = delete;
 		};
 
 		typedef std::shared_ptr<timer_target> timer_target_ptr;
@@ -79,21 +258,45 @@ namespace librf
 		bool expired() const;
 	};
 
+	/**
+	 * @brief 定时器管理器保存运行中的定时器的方式。
+	 */
+	enum struct timer_backend : uint8_t
+	{
+		rbtree,			///< 按到期时间排序的侵入式配对堆(沿用rbtree的名字)。精度与时钟一致，插入为O(1)，移除为均摊O(log n)，不需要分配内存
+		wheel,			///< 分层时间轮。插入和每个刻度的到期处理都是O(1)，不需要分配内存，精度为timer_manager::wheel_tick
+	};
+
+	/**
+	 * @brief 定时器管理器读取当前时间的方式。
+	 */
+	enum struct timer_clock_source : uint8_t
+	{
+		steady,			///< std::chrono::steady_clock
+		coarse,			///< 粗粒度的单调时钟(Linux下的CLOCK_MONOTONIC_COARSE)，读取更快，但精度只有几个毫秒。其他平台上等同于steady
+	};
+
 	/**
 	 * @brief 定时器管理器。
+	 * @details 定时器使用单调时钟，其他时钟的时间点会换算成单调时钟的时间点。\n
+	 * 默认使用timer_backend::rbtree保存运行中的定时器，精度与时钟一致。大量定时器并存，且可以接受wheel_tick的精度时，可以通过set_backend()切换到时间轮。
 	 */
 	struct timer_manager : public std::enable_shared_from_this<timer_manager>
 	{
 #ifndef DOXYGEN_SKIP_PROPERTY
+		typedef detail::timer_node timer_node;
 		typedef detail::timer_target timer_target;
 		typedef detail::timer_target_ptr timer_target_ptr;
 		typedef detail::timer_clock_type clock_type;
 		typedef clock_type::duration duration_type;
 		typedef clock_type::time_point time_point_type;
-
-		typedef std::vector<timer_target_ptr> timer_vector_type;
-		typedef std::multimap<clock_type::time_point, timer_target_ptr> timer_map_type;
 #endif
+		/**
+		 * @brief 时间轮的刻度。时间轮里的定时器，会在到期时间所在的刻度结束后触发，即最多延迟一个刻度。
+		 */
+		static constexpr duration_type wheel_tick = std::chrono::milliseconds(1);
+		static constexpr size_t wheel_bits = 8;							///< 时间轮每一层有2^wheel_bits个槽
+		static constexpr size_t wheel_levels = 4;						///< 时间轮的层数，总共可以覆盖2^32个刻度
 	public:
 		LIBRF_API timer_manager();
 		LIBRF_API ~timer_manager();
@@ -106,7 +309,7 @@ namespace librf
 		template<class _Clock, class _Duration = typename _Clock::duration, class _Cb>
 		timer_target_ptr add(const std::chrono::time_point<_Clock, _Duration> & tp_, _Cb && cb_)
 		{
-			return add_(std::chrono::time_point_cast<duration_type>(tp_), std::forward<_Cb>(cb_));
+			return add_(to_time_point(tp_), std::forward<_Cb>(cb_));
 		}
 		template<class _Rep, class _Period, class _Cb>
 		timer_handler add_handler(const std::chrono::duration<_Rep, _Period> & dt_, _Cb && cb_)
@@ -119,20 +322,120 @@ namespace librf
 			return{ this, add(tp_, std::forward<_Cb>(cb_)) };
 		}
 
+		/**
+		 * @brief 添加一个侵入式的定时器节点，到期时间为node->tp。可以在任意线程调用。
+		 * @details 节点由调用者拥有，且不能已经添加到某个定时器管理器里。在回调被调用之前，调用者必须保证节点有效。\n
+		 * 同一个节点，只能在回调被调用之后再次添加。
+		 */
+		LIBRF_API void add(timer_node * node);
+
+		/**
+		 * @brief 取消一个定时器。可以在任意线程调用。
+		 * @details 定时器在下一次update()时被移除，并调用回调，参数为true。
+		 * @return 定时器已经触发，或者已经被取消，则返回false。
+		 */
+		LIBRF_API bool stop(timer_node * node);
 		LIBRF_API bool stop(const timer_target_ptr & sptr);
 
+		/**
+		 * @brief 判断是否没有定时器。可以在任意线程调用。
+		 */
 		inline bool empty() const
 		{
-			return _runing_timers.empty() && _added_timers.empty();
+#if !RESUMEF_DISABLE_MULT_THREAD
+			scoped_lock<spinlock> __lock(_added_mtx);
+#endif
+			return _added_header == nullptr && _canceled_header == nullptr && _running_count.load(std::memory_order_relaxed) == 0;
 		}
 		LIBRF_API void clear();
 		LIBRF_API void update();
 
+		/**
+		 * @brief 获得最近一个定时器的到期时间点。没有定时器时，返回time_point_type::max()。
+		 * @details 只能在运行update()的线程里调用。已经被stop()的定时器，仍然计算在内。
+		 */
+		LIBRF_API time_point_type next_deadline();
+
+		/**
+		 * @brief 切换保存运行中的定时器的方式。
+		 * @details 只能在运行update()的线程里调用。已经添加的定时器，会迁移到新的后端里，其到期时间不变。
+		 */
+		LIBRF_API void set_backend(timer_backend backend);
+
+		/**
+		 * @brief 获得保存运行中的定时器的方式。
+		 */
+		timer_backend get_backend() const noexcept
+		{
+			return _backend;
+		}
+
+		/**
+		 * @brief 获得定时器时钟的当前时间。
+		 * @details 在所属调度器的批次里调用时，返回批次开始时update()读取的时间，不再读取时钟，
+		 * 故同一个批次里添加的大量相对定时器，只需要读取一次时钟。\n
+		 * 因此相对定时器从批次开始算起，而不是从调用时算起：批次里较晚才添加的相对定时器，最多提前批次已经运行的时长触发。\n
+		 * 在批次之外，例如在其他线程里，或者调度器没有运行时调用，则重新读取单调时钟。
+		 */
+		LIBRF_API time_point_type now() const noexcept;
+
+		/**
+		 * @brief 设置定时器默认允许延迟触发的时长，用于合并到期时间相近的定时器。
+		 * @details 定时器的到期时间会向上对齐到slack的整数倍，故到期时间落在同一个窗口里的定时器，会在同一个批次里一起触发，
+		 * 调度器被唤醒的次数也随之减少。代价是定时器最多延迟slack触发。
+
+		 * 只影响此后添加的定时器。节点的timer_node::slack不为inherit_slack时，使用节点自己的值。默认为0，即不合并。
+		 */
+		template<class _Rep, class _Period>
+		void set_slack(const std::chrono::duration<_Rep, _Period> & slack_) noexcept
+		{
+			_slack.store(std::chrono::duration_cast<duration_type>(slack_), std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 获得定时器默认允许延迟触发的时长。
+		 */
+		duration_type get_slack() const noexcept
+		{
+			return _slack.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 设置update()读取当前时间的方式。可以在任意线程、任意时刻调用。
+		 * @details update()每个批次读取一次时钟，判断哪些定时器已经到期，也作为批次里now()返回的时间。\n
+		 * 粗粒度的时钟落后于真实时间，到期判断只会让定时器延迟触发；但批次里的相对定时器也从这个较早的时间算起，
+		 * 最多再提前一个时钟刻度(通常为几个毫秒)触发。
+		 */
+		void set_clock_source(timer_clock_source source) noexcept
+		{
+			_clock_source.store(source, std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 获得update()读取当前时间的方式。
+		 */
+		timer_clock_source get_clock_source() const noexcept
+		{
+			return _clock_source.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief 将其他时钟的时间点，换算成定时器时钟的时间点。
+		 */
+		template<class _Clock, class _Duration>
+		static time_point_type to_time_point(const std::chrono::time_point<_Clock, _Duration> & tp_)
+		{
+			if constexpr (std::is_same_v<_Clock, clock_type>)
+				return std::chrono::time_point_cast<duration_type>(tp_);
+			else
+				return clock_type::now() + std::chrono::duration_cast<duration_type>(tp_ - _Clock::now());
+		}
+
 #ifndef DOXYGEN_SKIP_PROPERTY
 		template<class _Cb>
 		timer_target_ptr add_(const duration_type & dt_, _Cb && cb_)
 		{
-			return add_(std::make_shared<timer_target>(clock_type::now() + dt_, std::forward<_Cb>(cb_)));
+			return add_(std::make_shared<timer_target>(now() + dt_, std::forward<_Cb>(cb_)));
 		}
 		template<class _Cb>
 		timer_target_ptr add_(const time_point_type & tp_, _Cb && cb_)
@@ -140,14 +443,63 @@ namespace librf
 			return add_(std::make_shared<timer_target>(tp_, std::forward<_Cb>(cb_)));
 		}
 	private:
+		friend scheduler_t;
 #if !RESUMEF_DISABLE_MULT_THREAD
-		spinlock _added_mtx;
+		mutable spinlock _added_mtx;
 #endif
-		timer_vector_type	_added_timers;
-		timer_map_type		_runing_timers;
+		//其他线程添加定时器时，需要唤醒停靠在run()/run_for()里的调度器
+		scheduler_t* _scheduler = nullptr;
+		std::atomic<timer_clock_source> _clock_source{ timer_clock_source::steady };
+		time_point_type		_now;							//update()缓存的当前时间，用于判断到期，以及批次里的now()
+		std::atomic<duration_type> _slack{ duration_type::zero() };
+		//其他线程添加的节点，先放到这个链表里，由update()移到运行中的定时器里
+		timer_node*			_added_header = nullptr;
+		timer_node*			_added_tailer = nullptr;
+		//运行中被stop()的节点，由update()从运行中的定时器里移除。与_added_header共用_added_mtx
+		timer_node*			_canceled_header = nullptr;
+		//运行中的定时器组成的侵入式配对堆，堆顶是最早到期的定时器
+		timer_node*			_heap_root = nullptr;
+		size_t				_heap_count = 0;
+		uint64_t			_heap_seq = 0;
+		//运行中的定时器数量，由update()的线程发布，供其他线程的empty()读取
+		std::atomic<size_t> _running_count{ 0 };
+
+		struct wheel_slot
+		{
+			timer_node* _header = nullptr;
+			timer_node* _tailer = nullptr;
+		};
+		static constexpr uint64_t wheel_mask = (uint64_t{ 1 } << wheel_bits) - 1;
+
+		timer_backend		_backend = timer_backend::rbtree;
+		//wheel_levels * 2^wheel_bits个槽，使用时间轮时才分配
+		std::unique_ptr<wheel_slot[]> _wheel;
+		time_point_type		_wheel_base;					//第0个刻度开始的时间点
+		uint64_t			_wheel_tick = 0;				//下一个待处理的刻度，之前的刻度都已经处理过了
+		size_t				_wheel_count = 0;
+		size_t				_wheel_level_count[wheel_levels] = {};
 
 		LIBRF_API timer_target_ptr add_(const timer_target_ptr & sptr);
-		LIBRF_API static void call_target_(const timer_target_ptr & sptr, bool canceld);
+		LIBRF_API static void call_target_(timer_node * node, bool canceld);
+		time_point_type read_clock_() const noexcept;
+		void publish_running_() noexcept;
+
+		void apply_slack_(timer_node * node) const noexcept;
+		void insert_running_(timer_node * node);
+		void remove_running_(timer_node * node) noexcept;
+		timer_node* drain_running_() noexcept;
+		void reclaim_canceled_(timer_node * node);
+		void heap_push_(timer_node * node) noexcept;
+		timer_node* heap_pop_() noexcept;
+		void heap_erase_(timer_node * node) noexcept;
+		static bool heap_less_(const timer_node * a, const timer_node * b) noexcept;
+		static timer_node* heap_meld_(timer_node * a, timer_node * b) noexcept;
+		static timer_node* heap_merge_pairs_(timer_node * node) noexcept;
+		uint64_t wheel_expire_(const time_point_type & tp_) const noexcept;
+		void wheel_link_(timer_node * node) noexcept;
+		void wheel_cascade_(size_t level, size_t idx) noexcept;
+		void wheel_update_(const time_point_type & now_);
+		time_point_type wheel_deadline_() const noexcept;
 #endif
 	};
 
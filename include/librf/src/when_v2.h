@@ -40,6 +40,7 @@ namespace librf
 				scheduler_t* sch = parent_state->get_scheduler();
 
 				this->_scheduler = sch;
+				this->_priority = parent_state->get_priority();
 				this->_coro = handler;
 
 				return sch;
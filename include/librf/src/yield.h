@@ -19,10 +19,7 @@ namespace librf
 		template<class _PromiseT> requires(traits::is_promise_v<_PromiseT>)
 		bool await_suspend(coroutine_handle<_PromiseT> handler)
 		{
-			counted_ptr<state_t<void>> _state = state_future_t::_Alloc_state<state_type>(true);
-			_state->set_value();
-			_state->future_await_suspend(handler);
-
+			handler.promise().get_state()->yield_await_suspend(handler);
 			return true;
 		}
 		void await_resume() const noexcept
@@ -11,7 +11,7 @@ namespace librf
 			if (oldValue != nullptr && _value.compare_exchange_strong(oldValue, nullptr, std::memory_order_acq_rel))
 			{
 				*oldValue = nullptr;
-				_thandler.stop();
+				stop_timeout_timer();
 
 				this->_coro = nullptr;
 			}
@@ -23,11 +23,11 @@ namespace librf
 			if (oldValue != nullptr && _value.compare_exchange_strong(oldValue, nullptr, std::memory_order_acq_rel))
 			{
 				*oldValue = eptr;
-				_thandler.stop();
+				stop_timeout_timer();
 
 				assert(this->_scheduler != nullptr);
 				if (this->_coro)
-					this->_scheduler->add_generator(this);
+					this->_scheduler->add_run_next(this);
 
 				return true;
 			}
@@ -43,7 +43,6 @@ namespace librf
 				if (evt != nullptr)
 					evt->remove_wait_list(this);
 				*oldValue = nullptr;
-				_thandler.reset();
 
 				assert(this->_scheduler != nullptr);
 				if (this->_coro)
@@ -68,7 +67,7 @@ namespace librf
 			if (--_counter == 0)
 			{
 				*_result = false;
-				_thandler.stop();
+				stop_timeout_timer();
 
 				assert(this->_scheduler != nullptr);
 				if (this->_coro)
@@ -98,7 +97,7 @@ namespace librf
 				}
 
 				*_result = result;
-				_thandler.stop();
+				stop_timeout_timer();
 
 				assert(this->_scheduler != nullptr);
 				if (this->_coro)
@@ -116,7 +115,6 @@ namespace librf
 
 			_counter = 0;
 			*_result = false;
-			_thandler.reset();
 
 			for (sub_state_t& sub : _values)
 			{
@@ -32,7 +32,7 @@ namespace librf
 			if (oldValue != nullptr && _value.compare_exchange_strong(oldValue, nullptr, std::memory_order_acq_rel))
 			{
 				*oldValue = nullptr;
-				_thandler.stop();
+				stop_timeout_timer();
 
 				this->_coro = nullptr;
 			}
@@ -46,11 +46,11 @@ namespace librf
 			if (oldValue != nullptr && _value.compare_exchange_strong(oldValue, nullptr, std::memory_order_acq_rel))
 			{
 				*oldValue = eptr;
-				_thandler.stop();
+				stop_timeout_timer();
 
 				assert(this->_scheduler != nullptr);
 				if (this->_coro)
-					this->_scheduler->add_generator(this);
+					this->_scheduler->add_run_next(this);
 
 				return true;
 			}
@@ -63,7 +63,6 @@ namespace librf
 			if (oldValue != nullptr && _value.compare_exchange_strong(oldValue, nullptr, std::memory_order_acq_rel))
 			{
 				*oldValue = nullptr;
-				_thandler.reset();
 
 				assert(this->_scheduler != nullptr);
 				if (this->_coro)
@@ -74,14 +73,18 @@ namespace librf
 			return false;
 		}
 
-		LIBRF_API void state_mutex_t::add_timeout_timer(std::chrono::system_clock::time_point tp)
+		LIBRF_API void state_mutex_t::add_timeout_timer(timer_manager::time_point_type tp)
 		{
-			this->_thandler = this->_scheduler->timer()->add_handler(tp,
-				[st = counted_ptr<state_mutex_t>{ this }](bool canceld)
+			//定时器持有一个引用，在回调里释放
+			this->lock();
+			_timer.tp = tp;
+			_timer.cb = [this](bool canceld)
 				{
 					if (!canceld)
-						st->on_timeout();
-				});
+						this->on_timeout();
+					this->unlock();
+				};
+			this->_scheduler->timer()->add(&_timer);
 		}
 
 
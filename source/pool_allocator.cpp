@@ -0,0 +1,307 @@
+﻿#include "librf/librf.h"
+
+namespace librf
+{
+	namespace detail
+	{
+#if !RESUMEF_DISABLE_POOL_ALLOCATOR
+		static constexpr size_t pool_class_count = pool_max_size / pool_size_step;
+		static_assert(pool_max_size % pool_size_step == 0);
+
+		struct pool_heap;
+
+		struct pool_block
+		{
+			pool_block* _next;
+		};
+		static_assert(sizeof(pool_block) <= pool_size_step);
+
+		//每个大块只切分一个级别的内存块，并单独记录空闲的内存块，以便整个大块空闲时归还给系统
+		struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) pool_chunk
+		{
+			pool_heap* _owner;
+			size_t _class;
+			size_t _size;
+			//以下成员只由所属的线程访问
+			pool_block* _free = nullptr;
+			char* _bump;
+			char* _bump_end;
+			size_t _used = 0;						//分配出去的内存块数量，包括尚未回收的远程释放
+			//所属的堆里，同一级别、还能分配的大块组成的双链表
+			pool_chunk* _prev = nullptr;
+			pool_chunk* _next = nullptr;
+
+			pool_chunk(pool_heap* owner, size_t cls) noexcept
+				: _owner(owner)
+				, _class(cls)
+				, _size((cls + 1) * pool_size_step)
+				, _bump(reinterpret_cast<char*>(this + 1))
+				, _bump_end(reinterpret_cast<char*>(this) + pool_chunk_size)
+			{
+			}
+
+			bool full() const noexcept
+			{
+				return _free == nullptr && static_cast<size_t>(_bump_end - _bump) < _size;
+			}
+
+			static pool_chunk* from(void* ptr) noexcept
+			{
+				return reinterpret_cast<pool_chunk*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(pool_chunk_size - 1));
+			}
+		};
+
+		struct pool_heap
+		{
+			pool_chunk* _avail[pool_class_count] = {};
+			size_t _chunk_count = 0;
+			size_t _empty_count = 0;				//_used为0的大块数量
+			//其他线程释放的内存块
+			std::atomic<pool_block*> _remote{ nullptr };
+			//被放弃的堆组成的链表
+			pool_heap* _next_abandoned = nullptr;
+
+			void* allocate(size_t cls)
+			{
+				pool_chunk* chunk = _avail[cls];
+				if (unlikely(chunk == nullptr))
+				{
+					collect_remote_();
+					chunk = _avail[cls];
+					if (chunk == nullptr)
+						chunk = new_chunk_(cls);
+				}
+
+				void* ptr = chunk->_free;
+				if (likely(ptr != nullptr))
+				{
+					chunk->_free = chunk->_free->_next;
+				}
+				else
+				{
+					ptr = chunk->_bump;
+					chunk->_bump += chunk->_size;
+				}
+
+				if (unlikely(chunk->_used++ == 0))
+					--_empty_count;
+				if (unlikely(chunk->full()))
+					unlink_(chunk);
+				return ptr;
+			}
+
+			void deallocate(pool_chunk* chunk, void* ptr) noexcept
+			{
+				assert(chunk->_owner == this);
+				if (unlikely(chunk->full()))
+					link_(chunk);
+
+				pool_block* block = static_cast<pool_block*>(ptr);
+				block->_next = chunk->_free;
+				chunk->_free = block;
+
+				if (unlikely(--chunk->_used == 0))
+				{
+					//保留一部分空闲的大块，避免反复向系统申请；超过的部分归还给系统
+					if (_empty_count < pool_max_empty_chunks)
+						++_empty_count;
+					else
+						free_chunk_(chunk);
+				}
+			}
+
+			void deallocate_remote(void* ptr) noexcept
+			{
+				pool_block* block = static_cast<pool_block*>(ptr);
+				pool_block* header = _remote.load(std::memory_order_relaxed);
+				do
+				{
+					block->_next = header;
+				} while (!_remote.compare_exchange_weak(header, block, std::memory_order_release, std::memory_order_relaxed));
+			}
+
+			//线程退出时调用：回收远程释放的内存块，并归还所有空闲的大块。返回是否还有大块在使用
+			bool trim() noexcept
+			{
+				collect_remote_();
+				for (size_t cls = 0; cls < pool_class_count; ++cls)
+				{
+					for (pool_chunk* chunk = _avail[cls]; chunk != nullptr; )
+					{
+						pool_chunk* next = chunk->_next;
+						if (chunk->_used == 0)
+							free_chunk_(chunk);
+						chunk = next;
+					}
+				}
+				_empty_count = 0;
+				return _chunk_count > 0;
+			}
+		private:
+			void collect_remote_() noexcept
+			{
+				if (_remote.load(std::memory_order_relaxed) == nullptr)
+					return;
+
+				pool_block* block = _remote.exchange(nullptr, std::memory_order_acquire);
+				while (block != nullptr)
+				{
+					pool_block* next = block->_next;
+					deallocate(pool_chunk::from(block), block);
+					block = next;
+				}
+			}
+
+			pool_chunk* new_chunk_(size_t cls)
+			{
+				void* mem = ::operator new(pool_chunk_size, std::align_val_t{ pool_chunk_size });
+				pool_chunk* chunk = new(mem) pool_chunk{ this, cls };
+
+				++_chunk_count;
+				++_empty_count;
+				link_(chunk);
+				return chunk;
+			}
+
+			void free_chunk_(pool_chunk* chunk) noexcept
+			{
+				unlink_(chunk);
+				--_chunk_count;
+				chunk->~pool_chunk();
+				::operator delete(static_cast<void*>(chunk), std::align_val_t{ pool_chunk_size });
+			}
+
+			void link_(pool_chunk* chunk) noexcept
+			{
+				pool_chunk*& header = _avail[chunk->_class];
+				chunk->_prev = nullptr;
+				chunk->_next = header;
+				if (header != nullptr)
+					header->_prev = chunk;
+				header = chunk;
+			}
+
+			void unlink_(pool_chunk* chunk) noexcept
+			{
+				if (chunk->_prev != nullptr)
+					chunk->_prev->_next = chunk->_next;
+				else
+					_avail[chunk->_class] = chunk->_next;
+				if (chunk->_next != nullptr)
+					chunk->_next->_prev = chunk->_prev;
+				chunk->_prev = chunk->_next = nullptr;
+			}
+		};
+
+		static std::mutex g_pool_abandoned_mtx;
+		static pool_heap* g_pool_abandoned = nullptr;
+
+		static pool_heap* pool_acquire_heap_()
+		{
+			{
+				scoped_lock<std::mutex> __guard(g_pool_abandoned_mtx);
+				pool_heap* heap = g_pool_abandoned;
+				if (heap != nullptr)
+				{
+					g_pool_abandoned = heap->_next_abandoned;
+					heap->_next_abandoned = nullptr;
+					return heap;
+				}
+			}
+
+			return new pool_heap;
+		}
+
+		static void pool_abandon_heap_(pool_heap* heap)
+		{
+			//没有大块在使用时，不会再有其他线程访问这个堆；否则其他线程仍持有从这个堆分配的内存块，由之后新建的线程接管
+			if (!heap->trim())
+			{
+				delete heap;
+				return;
+			}
+
+			scoped_lock<std::mutex> __guard(g_pool_abandoned_mtx);
+			heap->_next_abandoned = g_pool_abandoned;
+			g_pool_abandoned = heap;
+		}
+
+		//线程退出后，仍然可能有thread_local对象的析构函数在释放内存，故th_pool_heap不能有析构函数
+		static thread_local pool_heap* th_pool_heap = nullptr;
+		//pool_heap_guard已经析构，此后本线程不再绑定堆
+		static thread_local bool th_pool_exited = false;
+
+		struct pool_heap_guard
+		{
+			~pool_heap_guard()
+			{
+				th_pool_exited = true;
+				pool_heap* heap = std::exchange(th_pool_heap, nullptr);
+				if (heap != nullptr)
+					pool_abandon_heap_(heap);
+			}
+		};
+
+		static void* pool_allocate_slow_(size_t cls)
+		{
+			if (unlikely(th_pool_exited))
+			{
+				//之后析构的thread_local对象仍在分配内存：借用一个堆，分配后立即放回，免得新建的堆没有人回收
+				pool_heap* heap = pool_acquire_heap_();
+				void* ptr = heap->allocate(cls);
+				pool_abandon_heap_(heap);
+				return ptr;
+			}
+
+			static thread_local pool_heap_guard __guard;
+			(void)__guard;
+
+			pool_heap* heap = pool_acquire_heap_();
+			th_pool_heap = heap;
+			return heap->allocate(cls);
+		}
+
+		static size_t pool_class_(size_t size) noexcept
+		{
+			return (size + pool_size_step - 1) / pool_size_step - 1;
+		}
+#endif	//!RESUMEF_DISABLE_POOL_ALLOCATOR
+
+		LIBRF_API void* pool_allocate(size_t size)
+		{
+#if RESUMEF_DISABLE_POOL_ALLOCATOR
+			return ::operator new(size);
+#else
+			if (unlikely(size == 0 || size > pool_max_size))
+				return ::operator new(size);
+
+			pool_heap* heap = th_pool_heap;
+			if (likely(heap != nullptr))
+				return heap->allocate(pool_class_(size));
+			return pool_allocate_slow_(pool_class_(size));
+#endif
+		}
+
+		LIBRF_API void pool_deallocate(void* ptr, size_t size) noexcept
+		{
+#if RESUMEF_DISABLE_POOL_ALLOCATOR
+			(void)size;
+			::operator delete(ptr);
+#else
+			if (unlikely(size == 0 || size > pool_max_size))
+			{
+				::operator delete(ptr);
+				return;
+			}
+
+			pool_chunk* chunk = pool_chunk::from(ptr);
+			assert(chunk->_class == pool_class_(size));
+			pool_heap* owner = chunk->_owner;
+			if (likely(owner == th_pool_heap))
+				owner->deallocate(chunk, ptr);
+			else
+				owner->deallocate_remote(ptr);
+#endif
+		}
+	}
+}
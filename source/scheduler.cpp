@@ -6,6 +6,7 @@ std::atomic<intptr_t> g_resumef_state_count = 0;
 std::atomic<intptr_t> g_resumef_task_count = 0;
 std::atomic<intptr_t> g_resumef_evtctx_count = 0;
 std::atomic<intptr_t> g_resumef_state_id = 0;
+std::atomic<intptr_t> g_resumef_timer_clock_count = 0;
 #endif
 
 namespace librf
@@ -20,6 +21,7 @@ namespace librf
 		"timer_canceled",
 		"not_await_lock",
 		"stop_requested",
+		"zero_capacity",
 	};
 
 	thread_local char sz_future_error_buffer[256];
@@ -38,6 +40,8 @@ namespace librf
 	}
 
 	thread_local scheduler_t * th_scheduler_ptr = nullptr;
+	//当前线程正在run_one_batch()的调度器
+	static thread_local scheduler_t * th_running_scheduler = nullptr;
 
 	//获得当前线程下的调度器
 	LIBRF_API scheduler_t * this_scheduler()
@@ -45,6 +49,18 @@ namespace librf
 		return th_scheduler_ptr ? th_scheduler_ptr : &scheduler_t::g_scheduler;
 	}
 
+	LIBRF_API std::pmr::memory_resource* detail::current_frame_resource() noexcept
+	{
+		scheduler_t* sch = th_running_scheduler ? th_running_scheduler : this_scheduler();
+		return sch->get_frame_resource();
+	}
+
+	LIBRF_API bool detail::current_thread_confined() noexcept
+	{
+		scheduler_t* sch = th_running_scheduler ? th_running_scheduler : this_scheduler();
+		return sch->is_thread_confined();
+	}
+
 	LIBRF_API local_scheduler_t::local_scheduler_t()
 	{
 		if (th_scheduler_ptr == nullptr)
@@ -78,9 +94,7 @@ namespace librf
 	LIBRF_API scheduler_t::scheduler_t()
 		: _timer(std::make_shared<timer_manager>())
 	{
-		_runing_states.reserve(1024);
-		_cached_states.reserve(1024);
-
+		_timer->_scheduler = this;
 		if (th_scheduler_ptr == nullptr)
 			th_scheduler_ptr = this;
 	}
@@ -88,20 +102,54 @@ namespace librf
 	LIBRF_API scheduler_t::~scheduler_t()
 	{
 		//cancel_all_task_();
+
+		//销毁尚未完成的task_t。先断开全部链接，state销毁时调用del_final()便不会再访问链表
+		task_t* task = std::exchange(_ready_task, nullptr);
+		while (task != nullptr)
+		{
+			task_t* next = task->_next_task;
+			task->_state->_task.store(nullptr, std::memory_order_relaxed);
+			task->_prev_task = nullptr;
+			task->_next_task = nullptr;
+			delete task;
+			task = next;
+		}
+
+		//释放就绪队列持有的引用计数
+		size_t count;
+		state_base_t* sptr = _batch_rest;
+		for (;;)
+		{
+			while (sptr != nullptr)
+			{
+				state_base_t* next = ready_queue_type::next(sptr);
+				ready_queue_type::release(sptr);
+				sptr->unlock();
+				sptr = next;
+			}
+
+			sptr = take_ready_(count);
+			if (sptr == nullptr)
+				break;
+		}
+
+		//定时管理器可能被timer_handler延长生存期
+		_timer->_scheduler = nullptr;
 		if (th_scheduler_ptr == this)
 			th_scheduler_ptr = nullptr;
 	}
 
-	LIBRF_API task_t* scheduler_t::new_task(task_t * task)
+	LIBRF_API task_t* scheduler_t::new_task(task_t * task, priority pri)
 	{
 		state_base_t* sptr = task->_state.get();
 		sptr->set_scheduler(this);
+		sptr->set_priority(pri);
 
 		{
 #if !RESUMEF_DISABLE_MULT_THREAD
 			scoped_lock<spinlock> __guard(_lock_ready);
 #endif
-			_ready_task.emplace(sptr, task);
+			link_task_(task);
 		}
 
 		//如果是单独的future，没有被co_await过，则handler是nullptr。
@@ -113,30 +161,76 @@ namespace librf
 		return task;
 	}
 
-	LIBRF_API std::unique_ptr<task_t> scheduler_t::del_switch(state_base_t* sptr)
+	LIBRF_API void scheduler_t::add_generator(state_base_t* sptr)
 	{
+		assert(sptr != nullptr);
+
+		//已经在就绪队列里了，合并成一次运行
+		if (unlikely(!ready_queue_type::claim(sptr)))
+			return;
+		sptr->lock();
+
 #if !RESUMEF_DISABLE_MULT_THREAD
-		scoped_lock<spinlock> __guard(_lock_ready);
+		if (th_running_scheduler != this)
+		{
+			_ready_levels[static_cast<size_t>(sptr->get_priority())]._queue.push_claimed(sptr);
+			notify_parked_();
+			return;
+		}
 #endif
-	
-		std::unique_ptr<task_t> task_ptr;
 
-		auto iter = this->_ready_task.find(sptr);
-		if (iter != this->_ready_task.end())
+		push_local_(sptr);
+	}
+
+	LIBRF_API void scheduler_t::add_run_next(state_base_t* sptr)
+	{
+		assert(sptr != nullptr);
+
+		//只有正在本线程运行的协程唤醒的state，才值得紧接着运行
+		if (th_running_scheduler != this)
 		{
-			task_ptr = std::exchange(iter->second, nullptr);
-			this->_ready_task.erase(iter);
+			add_generator(sptr);
+			return;
 		}
 
-		return task_ptr;
+		if (unlikely(!ready_queue_type::claim(sptr)))
+			return;
+		sptr->lock();
+
+		//不在恢复循环里，例如在批次开始时的定时器回调里唤醒的，没有人会取出槽位，直接排到本地链表里
+		if (!_resuming)
+		{
+			push_local_(sptr);
+			return;
+		}
+
+		//槽位里原来的state，排到本地链表的末尾
+		state_base_t* prev = std::exchange(_run_next, sptr);
+		if (prev != nullptr)
+			push_local_(prev);
+	}
+
+	LIBRF_API std::unique_ptr<task_t> scheduler_t::del_switch(state_base_t* sptr)
+	{
+#if !RESUMEF_DISABLE_MULT_THREAD
+		scoped_lock<spinlock> __guard(_lock_ready);
+#endif
+	
+		task_t* task = sptr->_task.load(std::memory_order_relaxed);
+		if (task != nullptr)
+			unlink_task_(task);
+
+		return std::unique_ptr<task_t>{ task };
 	}
 
 	LIBRF_API void scheduler_t::request_stop_all_if_possible()
 	{
+#if !RESUMEF_DISABLE_MULT_THREAD
 		scoped_lock<spinlock> __guard(_lock_ready);
+#endif
 
-		for (auto& kv : this->_ready_task)
-			kv.second->request_stop_if_possible();
+		for (task_t* task = this->_ready_task; task != nullptr; task = task->_next_task)
+			task->request_stop_if_possible();
 		//this->_ready_task.clear();
 		this->_timer->clear();
 	}
@@ -157,24 +251,210 @@ namespace librf
 	}
 */
 
+#if !RESUMEF_DISABLE_MULT_THREAD
+	size_t scheduler_t::handoff_states_(state_base_t* list, size_t count, scheduler_t* thief)
+	{
+		if (count < 2)
+			return 0;
+
+		//移交后一半。被via()固定在本调度器的协程，以及非future_t/generator_t的state，留在本调度器运行
+		_pool->_steal_begin.fetch_add(1, std::memory_order_acq_rel);
+
+		size_t moved = 0;
+		state_base_t* prev = list;
+		for (size_t i = 1; i < count / 2; ++i)
+			prev = ready_queue_type::next(prev);
+
+		for (state_base_t* sptr = ready_queue_type::next(prev); sptr != nullptr; )
+		{
+			state_base_t* next = ready_queue_type::next(sptr);
+			if (sptr->try_migrate(thief))
+			{
+				++moved;
+				ready_queue_type::set_next(prev, next);
+				ready_queue_type::release(sptr);
+
+				thief->add_generator(sptr);
+				sptr->unlock();
+			}
+			else
+			{
+				prev = sptr;
+			}
+			sptr = next;
+		}
+
+		_pool->_steal_end.fetch_add(1, std::memory_order_acq_rel);
+
+		return moved;
+	}
+#endif
+
+	state_base_t* scheduler_t::take_ready_(size_t& count) noexcept
+	{
+		state_base_t* header = nullptr;
+		state_base_t* tailer = nullptr;
+		count = 0;
+
+		//取出最高的非空优先级。更低的优先级被连续跳过priority_aging_limit批次后，也一起取出
+		bool taken = false;
+		for (ready_level_t& level : _ready_levels)
+		{
+			if (level.empty())
+			{
+				level._starved = 0;
+				continue;
+			}
+			if (taken && ++level._starved < priority_aging_limit)
+				continue;
+			level._starved = 0;
+			taken = true;
+
+			size_t level_count;
+			state_base_t* level_tailer;
+			state_base_t* list = level._queue.pop_all(level_count, level_tailer);
+
+			//本线程上次加入的，排在其他线程加入的之前
+			if (level._local_header != nullptr)
+			{
+				ready_queue_type::set_next(level._local_tailer, list);
+				if (list == nullptr)
+					level_tailer = level._local_tailer;
+				list = level._local_header;
+				level_count += level._local_count;
+
+				level._local_header = nullptr;
+				level._local_tailer = nullptr;
+				level._local_count = 0;
+			}
+
+			if (tailer != nullptr)
+				ready_queue_type::set_next(tailer, list);
+			else
+				header = list;
+			tailer = level_tailer;
+			count += level_count;
+		}
+
+		return header;
+	}
+
 	LIBRF_API bool scheduler_t::run_one_batch()
 	{
+		return run_batch_((std::numeric_limits<size_t>::max)(), std::chrono::steady_clock::time_point::max());
+	}
+
+	LIBRF_API bool scheduler_t::run_one_batch(size_t max_resumes)
+	{
+		assert(max_resumes > 0);
+		return run_batch_(max_resumes, std::chrono::steady_clock::time_point::max());
+	}
+
+	LIBRF_API bool scheduler_t::run_batch_(size_t max_resumes, std::chrono::steady_clock::time_point end_tp)
+	{
+		scheduler_t* prev_running = std::exchange(th_running_scheduler, this);
+
 		this->_timer->update();
 
+#if !RESUMEF_DISABLE_MULT_THREAD
+		scheduler_t* thief = nullptr;
+		if (unlikely(_pool != nullptr))
+			thief = _steal_request.exchange(nullptr, std::memory_order_acq_rel);
+#endif
+
+		size_t count;
+		state_base_t* sptr;
+
+		//上一批次异常退出时，槽位里可能还留有state
+		if (unlikely(_run_next != nullptr))
+			push_local_(std::exchange(_run_next, nullptr));
+
+		if (unlikely(_batch_rest != nullptr))
+		{
+			//上一批次没有运行完的，先运行完
+			sptr = std::exchange(_batch_rest, nullptr);
+			count = std::exchange(_batch_rest_count, 0);
+		}
+		else
+		{
+			sptr = take_ready_(count);
+		}
+		if (likely(sptr == nullptr))
 		{
 #if !RESUMEF_DISABLE_MULT_THREAD
-			scoped_lock<spinlock> __guard(_lock_running);
+			publish_ready_();
 #endif
-			if (likely(_runing_states.empty()))
-				return false;
+			th_running_scheduler = prev_running;
+			return false;
+		}
 
-			std::swap(_cached_states, _runing_states);
+#if !RESUMEF_DISABLE_MULT_THREAD
+		if (unlikely(_pool != nullptr))
+		{
+			_batch_size.store(count, std::memory_order_relaxed);
+			if (unlikely(thief != nullptr))
+				count -= handoff_states_(sptr, count, thief);
+			else if (count > 1)
+				_pool->wake_idle_(this);
 		}
+#endif
 
-		for (state_sptr& sptr : _cached_states)
-			sptr->resume();
+		const bool check_time = end_tp != std::chrono::steady_clock::time_point::max();
+		size_t run_next_count = 0;
+		_resuming = true;
+		while (sptr != nullptr)
+		{
+			--count;
+			state_base_t* next = ready_queue_type::next(sptr);
+			//从此刻开始，sptr可以被再次加入到就绪队列里
+			ready_queue_type::release(sptr);
 
-		_cached_states.clear();
+#if !RESUMEF_DISABLE_MULT_THREAD
+			//同一个协程链在本批次里有多个state时，其中一个被移交后，其余的也要转交到新的调度器上
+			scheduler_t* sch = unlikely(_pool != nullptr) ? sptr->get_scheduler() : this;
+			if (unlikely(sch != this && sch != nullptr))
+				sch->add_generator(sptr);
+			else
+#endif
+				sptr->resume();
+
+			sptr->unlock();
+
+			//刚刚被唤醒的state插到下一个运行。超过连续运行的上限后，排到本地链表里等下一批次
+			state_base_t* run_next = std::exchange(_run_next, nullptr);
+			if (run_next != nullptr && run_next_count < run_next_limit)
+			{
+				++run_next_count;
+				++count;
+				ready_queue_type::set_next(run_next, next);
+				next = run_next;
+			}
+			else
+			{
+				if (unlikely(run_next != nullptr))
+					push_local_(run_next);
+				run_next_count = 0;
+			}
+
+			sptr = next;
+
+			//超出限制，剩余的留到下一批次
+			if (unlikely(--max_resumes == 0 || (check_time && std::chrono::steady_clock::now() >= end_tp)))
+			{
+				if (sptr != nullptr)
+				{
+					_batch_rest = sptr;
+					_batch_rest_count = count;
+				}
+				break;
+			}
+		}
+		_resuming = false;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+		publish_ready_();
+#endif
+		th_running_scheduler = prev_running;
 		return true;
 	}
 
@@ -191,7 +471,7 @@ namespace librf
 #if !RESUMEF_DISABLE_MULT_THREAD
 				scoped_lock<spinlock> __guard(_lock_ready);
 #endif
-				if (likely(!_ready_task.empty())) continue;	//当前还存在task，则必然还有任务未完成
+				if (likely(_ready_task != nullptr)) continue;	//当前还存在task，则必然还有任务未完成
 			}
 			if (unlikely(!_timer->empty())) continue;			//定时器不为空，也需要等待定时器触发
 
@@ -199,5 +479,100 @@ namespace librf
 		};
 	}
 
+#if !RESUMEF_DISABLE_MULT_THREAD
+	void scheduler_t::notify_parked_() noexcept
+	{
+		//与park_until_()里的fence配对：要么停靠的线程能看到新加入的state/定时器，要么这里能看到_parked
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (unlikely(_parked.load(std::memory_order_relaxed)))
+		{
+			scoped_lock<std::mutex> __guard(_park_mtx);
+			_park_notified = true;
+			_park_cv.notify_one();
+		}
+	}
+#endif
+
+	bool scheduler_t::park_until_(std::chrono::steady_clock::time_point end_tp)
+	{
+		using namespace std::chrono;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+		std::unique_lock<std::mutex> __lock(_park_mtx);
+		_parked.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+
+		//最近的定时器到期时醒来
+		steady_clock::time_point wake_tp = end_tp;
+		timer_manager::time_point_type timer_tp = _timer->next_deadline();
+		if (timer_tp != timer_manager::time_point_type::max())
+		{
+			auto timer_dt = ceil<steady_clock::duration>(timer_tp - _timer->now());
+			if (timer_dt <= steady_clock::duration::zero())
+				wake_tp = steady_clock::time_point::min();
+			else
+				wake_tp = (std::min)(wake_tp, steady_clock::now() + timer_dt);
+		}
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+		auto pred = [this]
+		{
+			return _park_notified || !ready_empty_() || _run_stopped.load(std::memory_order_acquire);
+		};
+		if (wake_tp == steady_clock::time_point::max())
+			_park_cv.wait(__lock, pred);
+		else if (wake_tp != steady_clock::time_point::min())
+			_park_cv.wait_until(__lock, wake_tp, pred);
+
+		_park_notified = false;
+		_parked.store(false, std::memory_order_relaxed);
+		return true;
+#else
+		//单线程下没有其他线程能够唤醒
+		if (wake_tp == steady_clock::time_point::max())
+			return false;
+		if (wake_tp != steady_clock::time_point::min())
+			std::this_thread::sleep_until(wake_tp);
+		return true;
+#endif
+	}
+
+	LIBRF_API void scheduler_t::run_until_(std::chrono::steady_clock::time_point end_tp)
+	{
+		using namespace std::chrono;
+		const bool forever = end_tp == steady_clock::time_point::max();
+
+		for (;;)
+		{
+			if (unlikely(_run_stopped.load(std::memory_order_relaxed)) && _run_stopped.exchange(false, std::memory_order_acq_rel))
+				break;
+			if (!forever && steady_clock::now() >= end_tp)
+				break;
+
+			if (likely(this->run_one_batch())) continue;
+			if (!park_until_(end_tp))
+				break;
+		}
+	}
+
+	LIBRF_API void scheduler_t::run()
+	{
+		run_until_(std::chrono::steady_clock::time_point::max());
+	}
+
+	LIBRF_API void scheduler_t::stop()
+	{
+		_run_stopped.store(true, std::memory_order_release);
+#if !RESUMEF_DISABLE_MULT_THREAD
+		notify_parked_();
+#endif
+	}
+
+	LIBRF_API bool scheduler_t::is_running_in_this_thread() const noexcept
+	{
+		return th_running_scheduler == this;
+	}
+
 	LIBRF_API scheduler_t scheduler_t::g_scheduler;
 }
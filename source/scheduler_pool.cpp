@@ -0,0 +1,171 @@
+﻿#include "librf/librf.h"
+#include <algorithm>
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+
+namespace librf
+{
+	extern thread_local scheduler_t* th_scheduler_ptr;
+
+	LIBRF_API scheduler_pool_t::scheduler_pool_t(size_t thread_count)
+	{
+		if (thread_count == 0)
+			thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+		//scheduler_t的构造函数会尝试绑定到当前线程，而池里的调度器只能绑定到工作线程上
+		scheduler_t* saved_ptr = th_scheduler_ptr;
+
+		_schedulers.reserve(thread_count);
+		for (size_t idx = 0; idx < thread_count; ++idx)
+		{
+			std::unique_ptr<scheduler_t> sch{ new scheduler_t };
+			sch->_pool = this;
+			_schedulers.push_back(std::move(sch));
+		}
+
+		th_scheduler_ptr = saved_ptr;
+
+		_threads.reserve(thread_count);
+		for (size_t idx = 0; idx < thread_count; ++idx)
+			_threads.emplace_back(&scheduler_pool_t::run_worker_, this, idx);
+	}
+
+	LIBRF_API scheduler_pool_t::~scheduler_pool_t()
+	{
+		stop();
+	}
+
+	LIBRF_API void scheduler_pool_t::stop()
+	{
+		_stop.store(true, std::memory_order_release);
+		for (auto& sch : _schedulers)
+			sch->stop();
+
+		for (auto& th : _threads)
+		{
+			if (th.joinable())
+				th.join();
+		}
+	}
+
+	LIBRF_API bool scheduler_pool_t::empty() const
+	{
+		intptr_t steal_count = _steal_end.load(std::memory_order_acquire);
+		if (_steal_begin.load(std::memory_order_acquire) != steal_count)
+			return false;
+
+		for (auto& sch : _schedulers)
+		{
+			if (!sch->empty())
+				return false;
+		}
+
+		//检查期间发生过移交，则结果不可信
+		return _steal_begin.load(std::memory_order_acquire) == steal_count;
+	}
+
+	LIBRF_API void scheduler_pool_t::wait_until_notask() const
+	{
+		//与notify_idle_()配对：要么工作线程能看到等待者，要么这里能看到工作线程空闲前发布的状态
+		_idle_waiters.fetch_add(1, std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> __lock(_idle_mtx);
+			_idle_cv.wait(__lock, [this] { return empty(); });
+		}
+		_idle_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void scheduler_pool_t::notify_idle_() noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_idle_waiters.load(std::memory_order_relaxed) == 0)
+			return;
+
+		scoped_lock<std::mutex> __lock(_idle_mtx);
+		_idle_cv.notify_all();
+	}
+
+	void scheduler_pool_t::wake_idle_(scheduler_t* busy) noexcept
+	{
+		//与park_worker_()配对：要么空闲的工作线程登记后能窃取到，要么这里能看到它并唤醒
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (likely(_idle_count.load(std::memory_order_relaxed) == 0))
+			return;
+
+		for (auto& sch : _schedulers)
+		{
+			if (sch.get() != busy && sch->_parked.load(std::memory_order_relaxed))
+			{
+				sch->notify_parked_();
+				return;
+			}
+		}
+	}
+
+	bool scheduler_pool_t::request_steal_(size_t idx)
+	{
+		scheduler_t* thief = _schedulers[idx].get();
+
+		//选择就绪队列最长的调度器，至少要有两个就绪的state才值得窃取
+		scheduler_t* victim = nullptr;
+		size_t max_count = 1;
+		for (size_t i = 1; i < _schedulers.size(); ++i)
+		{
+			scheduler_t* sch = _schedulers[(idx + i) % _schedulers.size()].get();
+			size_t count = sch->ready_count_();
+			if (count > max_count)
+			{
+				max_count = count;
+				victim = sch;
+			}
+		}
+		if (victim == nullptr)
+			return false;
+
+		scheduler_t* expected = nullptr;
+		return victim->_steal_request.compare_exchange_strong(expected, thief, std::memory_order_acq_rel);
+	}
+
+	void scheduler_pool_t::run_worker_(size_t idx)
+	{
+		scheduler_t* sch = _schedulers[idx].get();
+		local_scheduler_t __bind(*sch);
+
+		size_t idle_count = 0;
+		while (!_stop.load(std::memory_order_acquire))
+		{
+			if (sch->run_one_batch() || request_steal_(idx))
+			{
+				idle_count = 0;
+				continue;
+			}
+
+			//先短暂的让出，很快就有新的state时，不必经过停靠和唤醒
+			if (++idle_count < 64)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			idle_count = 0;
+			park_worker_(idx);
+		}
+	}
+
+	void scheduler_pool_t::park_worker_(size_t idx)
+	{
+		scheduler_t* sch = _schedulers[idx].get();
+
+		_idle_count.fetch_add(1, std::memory_order_seq_cst);
+		//登记之后再尝试一次窃取，之后繁忙的调度器一定能看到本线程空闲
+		if (!request_steal_(idx))
+		{
+			notify_idle_();
+			//有新加入的state、到期的定时器、窃取移交过来的state，或者stop()时返回
+			sch->park_until_(std::chrono::steady_clock::time_point::max());
+		}
+		_idle_count.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+#endif	//!RESUMEF_DISABLE_MULT_THREAD
@@ -32,14 +32,25 @@ namespace librf
 		return nullptr;
 	}
 
+	LIBRF_API bool state_base_t::try_migrate(scheduler_t* sch)
+	{
+		(void)sch;
+		return false;
+	}
+
 	LIBRF_API void state_future_t::destroy_deallocate()
 	{
-		size_t _Size = this->_alloc_size;
+		size_t _Size = this->get_alloc_size();
+		bool in_frame = this->is_in_frame();
 #if RESUMEF_DEBUG_COUNTER
 		std::cout << "destroy_deallocate, size=" << _Size << std::endl;
 #endif
 		this->~state_future_t();
 
+		//与协程帧分配在一起的，由协程帧的分配器释放
+		if (in_frame)
+			return detail::frame_deallocate(this, _Size);
+
 		_Alloc_char _Al;
 		return _Al.deallocate(reinterpret_cast<char*>(this), _Size);
 	}
@@ -114,11 +125,32 @@ namespace librf
 		return true;
 	}
 
+	LIBRF_API bool state_generator_t::try_migrate(scheduler_t* sch)
+	{
+		//generator_t<>不支持co_await，故不可能通过via()指定调度器，总是可以被迁移
+		switch_scheduler_await_suspend(sch);
+		return true;
+	}
+
 	LIBRF_API state_base_t* state_future_t::get_parent() const noexcept
 	{
 		return _parent;
 	}
 
+	LIBRF_API bool state_future_t::try_migrate(scheduler_t* sch)
+	{
+		//同一个协程链上的state，共享根state上的标记
+		const state_future_t* root = this;
+		while (root->_parent != nullptr)
+			root = root->_parent;
+		if (root->_is_pinned)
+			return false;
+
+		//跟via()一样，将整条协程链切换到新的调度器上
+		switch_scheduler_await_suspend(sch);
+		return true;
+	}
+
 	LIBRF_API void state_future_t::resume()
 	{
 		std::unique_lock<lock_type> __guard(_mtx);
@@ -135,6 +167,7 @@ namespace librf
 			return;
 		}
 		
+		//协程结束时，promise_final_suspend()将本state加入就绪队列。因此，恢复等待者之后，还需要检查是否要销毁本协程。
 		if (_coro)
 		{
 			coroutine_handle<> handler = _coro;
@@ -142,7 +175,8 @@ namespace librf
 			__guard.unlock();
 
 			handler.resume();
-			return;
+
+			__guard.lock();
 		}
 
 		if (_is_initor == initor_type::Final)
@@ -229,4 +263,16 @@ namespace librf
 				sch->del_final(this);
 		}
 	}
+
+	LIBRF_API void state_t<void>::promise_return_value()
+	{
+		scoped_lock<lock_type> __guard(this->_mtx);
+		this->_has_value.store(result_type::Value, std::memory_order_release);
+	}
+
+	LIBRF_API void state_t<void>::promise_unhandled_exception(std::exception_ptr e)
+	{
+		scoped_lock<lock_type> __guard(this->_mtx);
+		this->_exception = std::move(e);
+	}
 }
@@ -0,0 +1,76 @@
+﻿#include "librf/librf.h"
+
+namespace librf
+{
+	namespace detail
+	{
+		LIBRF_API bool state_ticker_t::arm(coroutine_handle<> handler, state_base_t* parent)
+		{
+			scheduler_t* sch = parent->get_scheduler();
+			timer_manager* manager = sch->timer();
+
+			//第一次等待时开始计时；此后已经错过了计划触发时间，则不必挂起
+			timer_manager::time_point_type now_ = manager->now();
+			if (unlikely(_next == timer_manager::time_point_type{}))
+				_next = now_ + _period;
+			else if (take_ticks(now_) > 0)
+				return false;
+
+			this->_scheduler = sch;
+			this->_priority = parent->get_priority();
+			this->_coro = handler;
+
+			//定时器持有一个引用，在回调里释放
+			this->lock();
+			_timer.tp = _next;
+			_timer.cb = [this](bool canceld) { this->on_timer_(canceld); };
+
+			//与stop()配对：要么stop()能看到_manager，要么这里能看到_stopped
+			_manager.store(manager);
+			manager->add(&_timer);
+			if (unlikely(_stopped.load()))
+				manager->stop(&_timer);
+
+			return true;
+		}
+
+		LIBRF_API size_t state_ticker_t::take_ticks(const timer_manager::time_point_type& now_) noexcept
+		{
+			if (now_ < _next)
+				return 0;
+
+			//错过的触发不补发，而是合并到这一次里，并跳到now_之后的下一个计划触发时间
+			size_t ticks = 1 + static_cast<size_t>((now_ - _next) / _period);
+			_next += _period * static_cast<timer_manager::duration_type::rep>(ticks);
+			_ticks = ticks;
+
+			return ticks;
+		}
+
+		LIBRF_API void state_ticker_t::stop(bool wakeup) noexcept
+		{
+			//不再唤醒协程时，也不能让已经在就绪队列里的state恢复协程
+			if (!wakeup)
+				this->_coro = nullptr;
+
+			_stopped.store(true);
+			timer_manager* manager = _manager.load();
+			if (manager != nullptr && _timer.is_pending())
+				manager->stop(&_timer);
+		}
+
+		void state_ticker_t::on_timer_(bool canceld)
+		{
+			//被stop()取消时，唤醒协程，co_await返回0；被定时器管理器清理时，则不再唤醒
+			if (!canceld || is_stopped())
+			{
+				if (!canceld)
+					take_ticks((std::max)(_scheduler->timer()->now(), _next));
+				if (this->_coro)
+					this->_scheduler->add_generator(this);
+			}
+
+			this->unlock();
+		}
+	}
+}
@@ -1,10 +1,14 @@
 ﻿#include "librf/librf.h"
+#if defined(__linux__)
+#include <time.h>
+#endif
 
 namespace librf
 {
 	LIBRF_API timer_manager::timer_manager()
 	{
-		_added_timers.reserve(128);
+		if (_backend == timer_backend::wheel)
+			_wheel.reset(new wheel_slot[wheel_levels << wheel_bits]);
 	}
 
 	LIBRF_API timer_manager::~timer_manager()
@@ -12,15 +16,22 @@ namespace librf
 		clear();
 	}
 	
-	LIBRF_API void timer_manager::call_target_(const timer_target_ptr & sptr, bool canceld)
+	LIBRF_API void timer_manager::call_target_(timer_node * node, bool canceld)
 	{
-		auto cb = std::move(sptr->cb);
-		sptr->st = timer_target::State::Invalid;
+		//与stop()竞争。被stop()改为Canceled的节点，已经在取消链表里，由reclaim_canceled_()调用回调
+		auto st = node->st.load(std::memory_order_acquire);
+		do
+		{
+			if (st == timer_node::State::Canceled)
+				return;
+		} while (!node->st.compare_exchange_weak(st, timer_node::State::Invalid, std::memory_order_acq_rel, std::memory_order_acquire));
 #if _DEBUG
-		sptr->_manager = nullptr;
+		node->_manager = nullptr;
 #endif
 
-		if(cb) cb(canceld);
+		//回调里可能销毁或者重新添加节点，故先将回调移出来
+		auto cb = std::move(node->cb);
+		if (cb) cb(canceld || st == timer_node::State::AddCanceled);
 	}
 
 	LIBRF_API void timer_manager::clear()
@@ -28,96 +39,635 @@ namespace librf
 #if !RESUMEF_DISABLE_MULT_THREAD
 		std::unique_lock<spinlock> __lock(_added_mtx);
 #endif
-		auto _atimer = std::move(_added_timers);
+		timer_node* node = _added_header;
+		_added_header = _added_tailer = nullptr;
+		timer_node* canceled = std::exchange(_canceled_header, nullptr);
 #if !RESUMEF_DISABLE_MULT_THREAD
 		__lock.unlock();
 #endif
 
-		for (auto& sptr : _atimer)
-			call_target_(sptr, true);
+		while (node != nullptr)
+		{
+			timer_node* next = node->_next;
+			node->_next = nullptr;
+			call_target_(node, true);
+			node = next;
+		}
+
+		node = drain_running_();
+		while (node != nullptr)
+		{
+			timer_node* next = node->_next;
+			node->_next = nullptr;
+			call_target_(node, true);
+			node = next;
+		}
 
-		auto _rtimer = std::move(_runing_timers);
-		for (auto & kv : _rtimer)
-			call_target_(kv.second, true);
+		reclaim_canceled_(canceled);
+		publish_running_();
 	}
 
-	LIBRF_API detail::timer_target_ptr timer_manager::add_(const timer_target_ptr & sptr)
+	LIBRF_API void timer_manager::add(timer_node * node)
 	{
-		assert(sptr);
-		assert(sptr->st == timer_target::State::Invalid);
+		assert(node != nullptr);
+		assert(node->st.load(std::memory_order_relaxed) == timer_node::State::Invalid);
 
 #if !RESUMEF_DISABLE_MULT_THREAD
-		scoped_lock<spinlock> __lock(_added_mtx);
+		std::unique_lock<spinlock> __lock(_added_mtx);
 #endif
 #if _DEBUG
-		assert(sptr->_manager == nullptr);
-		sptr->_manager = this;
+		assert(node->_manager == nullptr);
+		node->_manager = this;
+#endif
+
+		node->st.store(timer_node::State::Added, std::memory_order_relaxed);
+		node->_next = nullptr;
+		if (_added_tailer != nullptr)
+			_added_tailer->_next = node;
+		else
+			_added_header = node;
+		_added_tailer = node;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+		__lock.unlock();
+		if (_scheduler != nullptr)
+			_scheduler->notify_parked_();
 #endif
+	}
+
+	LIBRF_API detail::timer_target_ptr timer_manager::add_(const timer_target_ptr & sptr)
+	{
+		assert(sptr);
 
-		sptr->st = timer_target::State::Added;
-		_added_timers.push_back(sptr);
+		sptr->_owner = sptr;
+		add(sptr.get());
 
 		return sptr;
 	}
 
-	LIBRF_API bool timer_manager::stop(const timer_target_ptr & sptr)
+	LIBRF_API bool timer_manager::stop(timer_node * node)
 	{
-		if (!sptr || sptr->st == timer_target::State::Invalid) 
-			return false;
+		auto st = node->st.load(std::memory_order_acquire);
+		for (;;)
+		{
+			if (st == timer_node::State::Added)
+			{
+				//还在待添加链表里，由update()移出链表后调用回调。在此之前节点仍然链接在链表里，is_pending()须保持为true
+				if (node->st.compare_exchange_weak(st, timer_node::State::AddCanceled, std::memory_order_acq_rel, std::memory_order_acquire))
+					return true;
+			}
+			else if (st == timer_node::State::Runing)
+			{
 #if _DEBUG
-		assert(sptr->_manager == this);
+				assert(node->_manager == this);
+#endif
+				//在锁内修改状态并加入取消链表，保证update()看到Canceled时，节点已经(或者即将)在取消链表里
+#if !RESUMEF_DISABLE_MULT_THREAD
+				std::unique_lock<spinlock> __lock(_added_mtx);
 #endif
-		sptr->st = timer_target::State::Invalid;
+				if (node->st.compare_exchange_strong(st, timer_node::State::Canceled, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					node->_canceled_next = _canceled_header;
+					_canceled_header = node;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+					__lock.unlock();
+					if (_scheduler != nullptr)
+						_scheduler->notify_parked_();
+#endif
+					return true;
+				}
+			}
+			else
+			{
+				return false;
+			}
+		}
+	}
 
-		return true;
+	LIBRF_API bool timer_manager::stop(const timer_target_ptr & sptr)
+	{
+		if (!sptr)
+			return false;
+		return stop(sptr.get());
 	}
 
 	LIBRF_API void timer_manager::update()
 	{
+		//每个批次只读取一次时钟，用来判断哪些定时器已经到期
+		_now = read_clock_();
+
 		{
 #if !RESUMEF_DISABLE_MULT_THREAD
 			std::unique_lock<spinlock> __lock(_added_mtx);
 #endif
+			timer_node* node = _added_header;
+			_added_header = _added_tailer = nullptr;
+			timer_node* canceled = std::exchange(_canceled_header, nullptr);
+			//取出的节点在update()结束之前，不在任何一个其他线程看得到的地方，此期间empty()不能返回true
+			if (node != nullptr)
+				_running_count.fetch_add(1, std::memory_order_relaxed);
+#if !RESUMEF_DISABLE_MULT_THREAD
+			__lock.unlock();
+#endif
+
+			//被取消的定时器，立即移除并调用回调，不必等到原来的到期时间
+			reclaim_canceled_(canceled);
 
-			if (unlikely(_added_timers.size() > 0))
+			while (node != nullptr)
 			{
-				auto _atimer = std::move(_added_timers);
-				_added_timers.reserve(128);
+				timer_node* next = node->_next;
+				node->_next = nullptr;
+
+				auto st = timer_node::State::Added;
+				if (node->st.compare_exchange_strong(st, timer_node::State::Runing, std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					apply_slack_(node);
+					insert_running_(node);
+				}
+				else
+				{
+					assert(st == timer_node::State::AddCanceled);
+					call_target_(node, true);
+				}
+
+				node = next;
+			}
+		}
+
+		if (_backend == timer_backend::wheel)
+		{
+			if (unlikely(_wheel_count > 0))
+				wheel_update_(_now);
+		}
+		else
+		{
+			//按到期的先后，依次取出堆顶已经到期的定时器
+			while (_heap_root != nullptr && _heap_root->tp <= _now)
+				call_target_(heap_pop_(), false);
+		}
+
+		publish_running_();
+	}
+
+	void timer_manager::publish_running_() noexcept
+	{
+		//取出的节点都已经插入运行中的定时器，或者已经调用了回调，可以直接发布准确的数量
+		_running_count.store(_heap_count + _wheel_count, std::memory_order_relaxed);
+	}
+
+	LIBRF_API timer_manager::time_point_type timer_manager::next_deadline()
+	{
+		time_point_type tp_ = _heap_root == nullptr ? time_point_type::max() : _heap_root->tp;
+		if (_wheel_count > 0)
+			tp_ = (std::min)(tp_, wheel_deadline_());
+
 #if !RESUMEF_DISABLE_MULT_THREAD
-				__lock.unlock();
+		scoped_lock<spinlock> __lock(_added_mtx);
 #endif
+		for (timer_node* node = _added_header; node != nullptr; node = node->_next)
+		{
+			if (node->tp < tp_)
+				tp_ = node->tp;
+		}
 
-				for (auto& sptr : _atimer)
+		return tp_;
+	}
+	LIBRF_API void timer_manager::set_backend(timer_backend backend)
+	{
+		if (backend == _backend)
+			return;
+
+		timer_node* node = drain_running_();
+
+		_backend = backend;
+		_now = read_clock_();
+		if (backend == timer_backend::wheel && !_wheel)
+			_wheel.reset(new wheel_slot[wheel_levels << wheel_bits]);
+
+		while (node != nullptr)
+		{
+			timer_node* next = node->_next;
+			insert_running_(node);
+			node = next;
+		}
+	}
+
+	void timer_manager::apply_slack_(timer_node * node) const noexcept
+	{
+		duration_type slack_ = node->slack;
+		if (slack_ < duration_type::zero())
+			slack_ = _slack.load(std::memory_order_relaxed);
+		if (slack_ <= duration_type::zero())
+			return;
+
+		//按时钟的纪元对齐，而不是按添加的时间，这样不同时刻添加的定时器才能落到同一个窗口里
+		auto since_epoch = node->tp.time_since_epoch();
+		if (since_epoch > time_point_type::max().time_since_epoch() - slack_)
+			return;
+		auto remain = since_epoch % slack_;
+		if (remain < duration_type::zero())
+			remain += slack_;
+		if (remain > duration_type::zero())
+			node->tp += slack_ - remain;
+	}
+
+	void timer_manager::insert_running_(timer_node * node)
+	{
+		if (_backend != timer_backend::wheel)
+		{
+			heap_push_(node);
+			return;
+		}
+
+		//时间轮为空时，可以任意选择当前刻度。从当前时间开始，避免update()跨越大段空闲的刻度
+		if (_wheel_count == 0)
+		{
+			_wheel_base = _now;
+			_wheel_tick = 0;
+		}
+
+		++_wheel_count;
+		wheel_link_(node);
+	}
+
+	timer_manager::timer_node* timer_manager::drain_running_() noexcept
+	{
+		//通过_next串成一个单链表返回
+		timer_node* header = nullptr;
+
+		for (timer_node* node = std::exchange(_heap_root, nullptr); node != nullptr; )
+		{
+			//将子节点链表接到兄弟链表的前面，不需要额外的栈就能遍历整个堆
+			if (node->_child != nullptr)
+			{
+				timer_node* tail = node->_child;
+				while (tail->_next != nullptr)
+					tail = tail->_next;
+				tail->_next = node->_next;
+				node->_next = std::exchange(node->_child, nullptr);
+			}
+
+			timer_node* next = node->_next;
+			node->_slot = timer_node::slot_none;
+			node->_prev = nullptr;
+			node->_next = header;
+			header = node;
+			node = next;
+		}
+		_heap_count = 0;
+
+		if (_wheel_count > 0)
+		{
+			for (size_t i = 0; i < (wheel_levels << wheel_bits); ++i)
+			{
+				wheel_slot& slot = _wheel[i];
+				for (timer_node* node = slot._header; node != nullptr; )
 				{
-					if (sptr->st == timer_target::State::Added)
-					{
-						sptr->st = timer_target::State::Runing;
-						_runing_timers.insert({ sptr->tp, sptr });
-					}
-					else
-					{
-						assert(sptr->st == timer_target::State::Invalid);
-						call_target_(sptr, true);
-					}
+					timer_node* next = node->_next;
+					node->_slot = timer_node::slot_none;
+					node->_prev = nullptr;
+					node->_next = header;
+					header = node;
+					node = next;
 				}
+				slot = {};
 			}
+
+			_wheel_count = 0;
+			for (auto& count : _wheel_level_count)
+				count = 0;
 		}
 
-		if (unlikely(_runing_timers.size() > 0))
+		return header;
+	}
+
+	void timer_manager::remove_running_(timer_node * node) noexcept
+	{
+		if (node->_slot == timer_node::slot_none)
+			return;
+
+		if (node->_slot == timer_node::slot_heap)
+		{
+			heap_erase_(node);
+		}
+		else
 		{
-			auto now_ = clock_type::now();
+			wheel_slot& slot = _wheel[node->_slot];
+			if (node->_prev != nullptr)
+				node->_prev->_next = node->_next;
+			else
+				slot._header = node->_next;
+			if (node->_next != nullptr)
+				node->_next->_prev = node->_prev;
+			else
+				slot._tailer = node->_prev;
+
+			--_wheel_level_count[node->_slot >> wheel_bits];
+			--_wheel_count;
+		}
 
-			auto iter = _runing_timers.begin();
-			for (; iter != _runing_timers.end(); ++iter)
+		node->_slot = timer_node::slot_none;
+		node->_prev = node->_next = nullptr;
+	}
+
+	void timer_manager::reclaim_canceled_(timer_node * node)
+	{
+		while (node != nullptr)
+		{
+			timer_node* next = node->_canceled_next;
+			node->_canceled_next = nullptr;
+
+			remove_running_(node);
+#if _DEBUG
+			node->_manager = nullptr;
+#endif
+			auto cb = std::move(node->cb);
+			node->st.store(timer_node::State::Invalid, std::memory_order_release);
+			if (cb) cb(true);
+
+			node = next;
+		}
+	}
+
+	bool timer_manager::heap_less_(const timer_node * a, const timer_node * b) noexcept
+	{
+		return a->tp < b->tp || (a->tp == b->tp && a->_seq < b->_seq);
+	}
+
+	timer_manager::timer_node* timer_manager::heap_meld_(timer_node * a, timer_node * b) noexcept
+	{
+		//a和b都是堆顶。较晚到期的成为另一个的第一个子节点
+		if (heap_less_(b, a))
+			std::swap(a, b);
+
+		b->_prev = a;
+		b->_next = a->_child;
+		if (a->_child != nullptr)
+			a->_child->_prev = b;
+		a->_child = b;
+		a->_prev = a->_next = nullptr;
+
+		return a;
+	}
+
+	timer_manager::timer_node* timer_manager::heap_merge_pairs_(timer_node * node) noexcept
+	{
+		if (node == nullptr)
+			return nullptr;
+
+		//第一遍从左到右两两合并，结果通过_next逆序串起来；第二遍再从右到左依次合并
+		timer_node* pairs = nullptr;
+		while (node != nullptr)
+		{
+			timer_node* a = node;
+			timer_node* b = a->_next;
+			if (b == nullptr)
 			{
-				auto & kv = *iter;
-				if (kv.first > now_)
-					break;
+				a->_prev = nullptr;
+				a->_next = pairs;
+				pairs = a;
+				break;
+			}
+
+			node = b->_next;
+			timer_node* merged = heap_meld_(a, b);
+			merged->_next = pairs;
+			pairs = merged;
+		}
+
+		timer_node* root = pairs;
+		pairs = std::exchange(root->_next, nullptr);
+		while (pairs != nullptr)
+		{
+			timer_node* next = pairs->_next;
+			root = heap_meld_(root, pairs);
+			pairs = next;
+		}
+
+		return root;
+	}
+
+	void timer_manager::heap_push_(timer_node * node) noexcept
+	{
+		node->_slot = timer_node::slot_heap;
+		node->_seq = _heap_seq++;
+		node->_child = node->_prev = node->_next = nullptr;
+
+		_heap_root = _heap_root != nullptr ? heap_meld_(_heap_root, node) : node;
+		++_heap_count;
+	}
+
+	timer_manager::timer_node* timer_manager::heap_pop_() noexcept
+	{
+		timer_node* node = _heap_root;
+		_heap_root = heap_merge_pairs_(std::exchange(node->_child, nullptr));
+		--_heap_count;
+
+		node->_slot = timer_node::slot_none;
+		node->_prev = node->_next = nullptr;
+		return node;
+	}
+
+	void timer_manager::heap_erase_(timer_node * node) noexcept
+	{
+		if (node == _heap_root)
+		{
+			heap_pop_();
+			return;
+		}
+
+		//从父节点或者左边的兄弟上摘下，其子节点合并后再放回堆里
+		if (node->_prev->_child == node)
+			node->_prev->_child = node->_next;
+		else
+			node->_prev->_next = node->_next;
+		if (node->_next != nullptr)
+			node->_next->_prev = node->_prev;
+
+		timer_node* sub = heap_merge_pairs_(std::exchange(node->_child, nullptr));
+		if (sub != nullptr)
+			_heap_root = heap_meld_(_heap_root, sub);
+		--_heap_count;
+
+		node->_slot = timer_node::slot_none;
+		node->_prev = node->_next = nullptr;
+	}
+
+	uint64_t timer_manager::wheel_expire_(const time_point_type & tp_) const noexcept
+	{
+		if (tp_ <= _wheel_base)
+			return _wheel_tick;
+
+		//向上取整，保证定时器不会提前触发
+		auto dt = tp_ - _wheel_base;
+		uint64_t expire = static_cast<uint64_t>(dt / wheel_tick);
+		if (dt % wheel_tick != duration_type::zero())
+			++expire;
+
+		return (std::max)(expire, _wheel_tick);
+	}
+
+	void timer_manager::wheel_link_(timer_node * node) noexcept
+	{
+		uint64_t expire = wheel_expire_(node->tp);
+		uint64_t delta = expire - _wheel_tick;
+
+		size_t level = 0;
+		while (level < wheel_levels - 1 && delta >= (uint64_t{ 1 } << (wheel_bits * (level + 1))))
+			++level;
 
-				call_target_(kv.second, kv.second->st == timer_target::State::Invalid);
+		//超出时间轮范围的，先放到最远的槽里，级联时再根据到期时间重新放置
+		constexpr uint64_t wheel_range = uint64_t{ 1 } << (wheel_bits * wheel_levels);
+		if (delta >= wheel_range)
+			expire = _wheel_tick + wheel_range - 1;
+
+		size_t idx = static_cast<size_t>((expire >> (wheel_bits * level)) & wheel_mask);
+		wheel_slot& slot = _wheel[(level << wheel_bits) + idx];
+
+		node->_slot = static_cast<uint16_t>((level << wheel_bits) + idx);
+		node->_prev = slot._tailer;
+		node->_next = nullptr;
+		if (slot._tailer != nullptr)
+			slot._tailer->_next = node;
+		else
+			slot._header = node;
+		slot._tailer = node;
+
+		++_wheel_level_count[level];
+	}
+
+	void timer_manager::wheel_cascade_(size_t level, size_t idx) noexcept
+	{
+		wheel_slot& slot = _wheel[(level << wheel_bits) + idx];
+		timer_node* node = slot._header;
+		slot = {};
+
+		while (node != nullptr)
+		{
+			timer_node* next = node->_next;
+			--_wheel_level_count[level];
+			wheel_link_(node);
+			node = next;
+		}
+	}
+
+	void timer_manager::wheel_update_(const time_point_type & now_)
+	{
+		if (now_ < _wheel_base)
+			return;
+		const uint64_t target = static_cast<uint64_t>((now_ - _wheel_base) / wheel_tick);
+
+		while (_wheel_count > 0 && _wheel_tick <= target)
+		{
+			//低层转完一圈，将高层对应槽里的定时器重新放置到低层
+			if ((_wheel_tick & wheel_mask) == 0)
+			{
+				for (size_t level = 1; level < wheel_levels; ++level)
+				{
+					size_t idx = static_cast<size_t>((_wheel_tick >> (wheel_bits * level)) & wheel_mask);
+					wheel_cascade_(level, idx);
+					if (idx != 0)
+						break;
+				}
+			}
+
+			//低层都是空的，直接跳到下一次需要级联的刻度
+			if (_wheel_level_count[0] == 0)
+			{
+				size_t bits = wheel_bits;
+				for (size_t level = 1; level < wheel_levels - 1 && _wheel_level_count[level] == 0; ++level)
+					bits += wheel_bits;
+
+				uint64_t next_tick = ((_wheel_tick >> bits) + 1) << bits;
+				_wheel_tick = (std::min)(next_tick, target + 1);
+				continue;
 			}
 
-			_runing_timers.erase(_runing_timers.begin(), iter);
+			wheel_slot& slot = _wheel[static_cast<size_t>(_wheel_tick & wheel_mask)];
+			timer_node* node = slot._header;
+			slot = {};
+			++_wheel_tick;
+
+			while (node != nullptr)
+			{
+				timer_node* next = node->_next;
+				node->_slot = timer_node::slot_none;
+				node->_prev = node->_next = nullptr;
+
+				--_wheel_level_count[0];
+				--_wheel_count;
+				call_target_(node, false);
+
+				node = next;
+			}
 		}
 	}
+
+	timer_manager::time_point_type timer_manager::wheel_deadline_() const noexcept
+	{
+		//第0层的槽与刻度一一对应，找到的第一个非空槽就是最近的到期刻度
+		if (_wheel_level_count[0] > 0)
+		{
+			for (uint64_t tick = _wheel_tick; tick <= _wheel_tick + wheel_mask; ++tick)
+			{
+				if (_wheel[static_cast<size_t>(tick & wheel_mask)]._header != nullptr)
+					return _wheel_base + wheel_tick * static_cast<duration_type::rep>(tick);
+			}
+		}
+
+		//高层的槽只能给出级联的刻度。到时唤醒后级联，再计算准确的到期刻度
+		uint64_t min_tick = (std::numeric_limits<uint64_t>::max)();
+		for (size_t level = 1; level < wheel_levels; ++level)
+		{
+			if (_wheel_level_count[level] == 0)
+				continue;
+
+			const size_t shift = wheel_bits * level;
+			const uint64_t base_idx = _wheel_tick >> shift;
+			//当前刻度恰好是级联的刻度，则当前槽还没有级联
+			uint64_t j = (_wheel_tick & ((uint64_t{ 1 } << shift) - 1)) == 0 ? 0 : 1;
+			for (; j <= wheel_mask + 1; ++j)
+			{
+				if (_wheel[(level << wheel_bits) + static_cast<size_t>((base_idx + j) & wheel_mask)]._header != nullptr)
+				{
+					min_tick = (std::min)(min_tick, (base_idx + j) << shift);
+					break;
+				}
+			}
+		}
+
+		if (min_tick == (std::numeric_limits<uint64_t>::max)())
+			return time_point_type::max();
+		return _wheel_base + wheel_tick * static_cast<duration_type::rep>(min_tick);
+	}
+
+	LIBRF_API timer_manager::time_point_type timer_manager::now() const noexcept
+	{
+		//_now只由运行批次的线程读写，故只有在本调度器的批次里才能使用
+		if (_scheduler != nullptr && _scheduler->is_running_in_this_thread())
+			return _now;
+
+#if RESUMEF_DEBUG_COUNTER
+		++g_resumef_timer_clock_count;
+#endif
+		return clock_type::now();
+	}
+
+	timer_manager::time_point_type timer_manager::read_clock_() const noexcept
+	{
+#if RESUMEF_DEBUG_COUNTER
+		++g_resumef_timer_clock_count;
+#endif
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+		//steady_clock在Linux下使用CLOCK_MONOTONIC，与CLOCK_MONOTONIC_COARSE的起点相同
+		if (_clock_source.load(std::memory_order_relaxed) == timer_clock_source::coarse)
+		{
+			timespec ts;
+			if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) == 0)
+				return time_point_type{ std::chrono::duration_cast<duration_type>(std::chrono::seconds{ ts.tv_sec } + std::chrono::nanoseconds{ ts.tv_nsec }) };
+		}
+#endif
+		return clock_type::now();
+	}
 }
\ No newline at end of file
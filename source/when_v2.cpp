@@ -7,6 +7,7 @@ namespace librf
 		LIBRF_API state_when_t::state_when_t(intptr_t counter_)
 			:_counter(counter_)
 		{
+			disable_confined();
 		}
 
 		LIBRF_API void state_when_t::resume()
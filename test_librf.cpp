@@ -23,6 +23,12 @@ extern void resumable_main_when_all();
 extern void resumable_main_layout();
 extern void resumable_main_switch_scheduler();
 extern void resumable_main_stop_token();
+extern void resumable_main_scheduler_pool();
+extern void resumable_main_scheduler_run();
+extern void resumable_main_priority();
+extern void resumable_main_timer_wheel();
+extern void resumable_main_frame_allocator();
+extern void resumable_main_lazy();
 
 extern void resumable_main_benchmark_mem(bool wait_key);
 extern void benchmark_main_channel_passing_next();
@@ -68,6 +74,12 @@ int main(int argc, const char* argv[])
 	resumable_main_when_all();
 	resumable_main_switch_scheduler();
 	resumable_main_stop_token();
+	resumable_main_scheduler_pool();
+	resumable_main_scheduler_run();
+	resumable_main_priority();
+	resumable_main_timer_wheel();
+	resumable_main_frame_allocator();
+	resumable_main_lazy();
 	std::cout << "ALL OK!" << std::endl;
 
 	benchmark_main_channel_passing_next();
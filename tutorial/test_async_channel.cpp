@@ -4,6 +4,9 @@
 #include <thread>
 #include <deque>
 #include <mutex>
+#include <vector>
+#include <numeric>
+#include <iterator>
 
 #include "librf/librf.h"
 
@@ -91,6 +94,72 @@ void test_channel_write_first()
 	this_scheduler()->run_until_notask();
 }
 
+//批量读写：一次加锁处理尽量多的数据，只在通道满/空时才挂起
+void test_channel_batch()
+{
+	channel_t<int> c{ 4 };
+
+	go[c]() -> future_t<>
+	{
+		std::vector<int> values(10);
+		std::iota(values.begin(), values.end(), 0);
+		co_await c.write_range(values.begin(), values.end());
+	};
+	go[c]() -> future_t<>
+	{
+		std::vector<int> values;
+		while (values.size() < 10)
+		{
+			size_t count = co_await c.read_n(std::back_inserter(values), 10 - values.size());
+			std::cout << "read " << count << " values" << std::endl;
+		}
+		assert(std::accumulate(values.begin(), values.end(), 0) == 45);
+	};
+
+	this_scheduler()->run_until_notask();
+}
+
+//同时等待多个channel，只有最先完成的分支生效，其他分支不会读走数据
+void test_channel_select()
+{
+	channel_t<int> c1{ 1 };
+	channel_t<std::string> c2{ 1 };
+	channel_t<int> c3{ 0 };
+
+	go[=]() -> future_t<>
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			auto [index, value] = co_await select(c1.read(), c2.read(), c3 << i, timeout(100ms));
+			switch (index)
+			{
+			case 0: std::cout << "select c1: " << std::any_cast<int>(value) << std::endl; break;
+			case 1: std::cout << "select c2: " << std::any_cast<std::string>(value) << std::endl; break;
+			case 2: std::cout << "select c3 <- " << i << std::endl; break;
+			default: std::cout << "select timeout" << std::endl; break;
+			}
+		}
+
+		auto [index, value] = co_await select(c1.read(), timeout(10ms));
+		assert(index == 1);
+		(void)index;
+	};
+	go[=]() -> future_t<>
+	{
+		co_await sleep_for(10ms);
+		co_await(c2 << std::string("hello"));
+		co_await sleep_for(10ms);
+		co_await(c1 << 1);
+		co_await sleep_for(10ms);
+		int val = co_await c3;
+		assert(val == 2);
+		(void)val;
+		assert(!c1.try_read(val));
+	};
+
+	this_scheduler()->run_until_notask();
+}
+
 static const int N = 1000000;
 
 void test_channel_performance_single_thread(size_t buff_size)
@@ -175,16 +244,16 @@ void test_channel_performance_four_thread(size_t buff_size)
 	for (int i = 0; i < 4; ++i) {
 		wr_th[i] = std::thread([c, q] {
 			for (int i = N - 1; i >= 0; --i)
-				(void)(c << i);
-			(void)(q << true);
+				c.write_sync(i);
+			q.write_sync(true);
 		});
 	}
 
 	for (int i = 0; i < 4; ++i) {
 		rd_th[i] = std::thread([c, q] {
 			for (int i = N - 1; i >= 0; --i)
-				(void)c.read();
-			(void)(q << true);
+				(void)c.read_sync();
+			q.write_sync(true);
 		});
 	}
 
@@ -250,6 +319,12 @@ void resumable_main_channel()
 	test_channel_write_first();
 	std::cout << std::endl;
 
+	test_channel_batch();
+	std::cout << std::endl;
+
+	test_channel_select();
+	std::cout << std::endl;
+
 	std::cout << "single thread" << std::endl;
 	test_channel_performance_single_thread(1);
 	test_channel_performance_single_thread(10);
@@ -64,8 +64,75 @@ const size_t READ_THREAD = 6;
 const size_t READ_BATCH = 1000000;
 const size_t MAX_CHANNEL_QUEUE = 5;		//0, 1, 5, 10, -1
 
+//mpsc/spsc模式的channel，只有一个读者线程
+template<channel_mode _Mode>
+void test_lockfree_channel_mult_thread(size_t write_threads)
+{
+	using channel_type = channel_t<intptr_t, false, false, _Mode>;
+	channel_type c(MAX_CHANNEL_QUEUE);
+
+	const intptr_t count = READ_BATCH;
+	std::vector<std::thread> write_th;
+	for (size_t i = 0; i < write_threads; ++i)
+	{
+		write_th.emplace_back([&]
+		{
+			local_scheduler_t my_scheduler;
+			go [&]() -> future_t<>
+			{
+				for (intptr_t i = 1; i <= count; ++i)
+					co_await c.write(i);
+			};
+			this_scheduler()->run_until_notask();
+		});
+	}
+
+	intptr_t sum = 0;
+	auto start = high_resolution_clock::now();
+	std::thread read_th([&]
+	{
+		local_scheduler_t my_scheduler;
+		go [&]() -> future_t<>
+		{
+			for (size_t i = 0; i < count * write_threads; ++i)
+				sum += co_await c.read();
+		};
+		this_scheduler()->run_until_notask();
+	});
+
+	read_th.join();
+	for (auto& th : write_th)
+		th.join();
+
+	auto dt = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+	std::cout << (_Mode == channel_mode::spsc ? "spsc" : "mpsc") << ": " << count * write_threads << " messages in " << dt << "ms" << std::endl;
+	assert(sum == static_cast<intptr_t>(write_threads) * count * (count + 1) / 2);
+	(void)sum;
+}
+
+//无锁模式的channel必须有缓存
+static void test_lockfree_channel_zero_capacity()
+{
+	bool rejected = false;
+	try
+	{
+		mpsc_channel_t<intptr_t> c(0);
+	}
+	catch (const channel_exception& e)
+	{
+		rejected = e._error == error_code::zero_capacity;
+	}
+	assert(rejected);
+	(void)rejected;
+}
+
 void resumable_main_channel_mult_thread()
 {
+	//先运行无锁模式的测试，免得被后面耗时较长的mpmc测试挡住
+	test_lockfree_channel_zero_capacity();
+	test_lockfree_channel_mult_thread<channel_mode::spsc>(1);
+	test_lockfree_channel_mult_thread<channel_mode::mpsc>(WRITE_THREAD);
+
 	channel_t<std::string> c(MAX_CHANNEL_QUEUE);
 
 	std::thread write_th[WRITE_THREAD];
@@ -0,0 +1,119 @@
+﻿#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <memory_resource>
+
+#include "librf/librf.h"
+
+//带分配器的operator new是模板，而释放协程帧用的是非模板的operator delete(void*, size_t)。
+//GCC在-O0下据此报告new/delete不匹配，这是误报：协程帧总是通过operator delete(void*, size_t)释放
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+using namespace librf;
+
+//统计分配次数的内存资源
+struct counting_resource : public std::pmr::memory_resource
+{
+	size_t _allocs = 0;
+	size_t _deallocs = 0;
+	std::pmr::memory_resource* _upstream;
+
+	explicit counting_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+		: _upstream(upstream)
+	{
+	}
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		++_allocs;
+		return _upstream->allocate(bytes, alignment);
+	}
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		++_deallocs;
+		_upstream->deallocate(p, bytes, alignment);
+	}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+//第一个参数为std::allocator_arg，协程帧从第二个参数指定的分配器里分配
+static future_t<int> frame_arena_task(std::allocator_arg_t, std::pmr::memory_resource*, int v)
+{
+	co_await yield();
+	co_return v * 2;
+}
+
+static future_t<int> frame_polymorphic_task(std::allocator_arg_t, std::pmr::polymorphic_allocator<> , int v)
+{
+	co_await yield();
+	co_return v + 1;
+}
+
+static generator_t<int> frame_arena_generator(std::allocator_arg_t, std::pmr::memory_resource*, int n)
+{
+	for (int i = 0; i < n; ++i)
+		co_yield i;
+}
+
+static future_t<> frame_default_task()
+{
+	co_await yield();
+}
+
+void resumable_main_frame_allocator()
+{
+	std::cout << __FUNCTION__ << std::endl;
+
+	counting_resource res;
+
+	int result = 0;
+	go[&]() -> future_t<>
+	{
+		result += co_await frame_arena_task(std::allocator_arg, &res, 10);
+		result += co_await frame_polymorphic_task(std::allocator_arg, std::pmr::polymorphic_allocator<>{ &res }, 10);
+
+		//lambda形式的协程，跳过闭包对象后，第一个参数为std::allocator_arg
+		auto lambda_task = [](std::allocator_arg_t, std::pmr::memory_resource*, int v) -> future_t<int>
+		{
+			co_return v;
+		};
+		result += co_await lambda_task(std::allocator_arg, &res, 1);
+	};
+	this_scheduler()->run_until_notask();
+
+	int sum = 0;
+	for (int v : frame_arena_generator(std::allocator_arg, &res, 5))
+		sum += v;
+
+	std::cout << "allocator_arg: result=" << result << ", sum=" << sum << ", allocs=" << res._allocs << ", deallocs=" << res._deallocs << std::endl;
+	assert(result == 32);
+	assert(res._allocs == 4 && res._deallocs == 4);
+
+	//调度器的默认内存资源，用于没有指定分配器的协程
+	char buffer[4096];
+	std::pmr::monotonic_buffer_resource arena{ buffer, sizeof(buffer) };
+	counting_resource arena_res{ &arena };
+
+	this_scheduler()->set_frame_resource(&arena_res);
+	for (int i = 0; i < 8; ++i)
+		go frame_default_task();
+	this_scheduler()->run_until_notask();
+	this_scheduler()->set_frame_resource(nullptr);
+
+	std::cout << "scheduler resource: allocs=" << arena_res._allocs << ", deallocs=" << arena_res._deallocs << std::endl;
+	assert(arena_res._allocs == 8 && arena_res._deallocs == 8);
+}
+
+#if LIBRF_TUTORIAL_STAND_ALONE
+int main()
+{
+	resumable_main_frame_allocator();
+	return 0;
+}
+#endif
@@ -0,0 +1,96 @@
+﻿#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "librf/librf.h"
+
+using namespace librf;
+using namespace std::chrono;
+
+//深层的同步调用，每一层都是lazy_t<>，不经过调度器
+static lazy_t<int64_t> lazy_fib(int n)
+{
+	if (n < 2)
+		co_return n;
+	int64_t a = co_await lazy_fib(n - 1);
+	int64_t b = co_await lazy_fib(n - 2);
+	co_return a + b;
+}
+
+static int g_lazy_value = 0;
+static lazy_t<int&> lazy_ref()
+{
+	co_return g_lazy_value;
+}
+
+static lazy_t<> lazy_throw()
+{
+	throw std::logic_error("lazy_throw");
+	co_return;
+}
+
+//在lazy_t<>里，同样可以等待librf的可等待对象
+static lazy_t<std::string> lazy_sleep_and_yield(std::string s)
+{
+	co_await sleep_for(10ms);
+	co_await yield();
+
+	scheduler_t* sch = librf_current_scheduler();
+	assert(sch == this_scheduler());
+	(void)sch;
+
+	co_return s + "!";
+}
+
+static lazy_t<> lazy_not_awaited(bool* started)
+{
+	*started = true;
+	co_return;
+}
+
+void resumable_main_lazy()
+{
+	std::cout << __FUNCTION__ << std::endl;
+
+	bool started = false;
+	go[&]() -> future_t<>
+	{
+		int64_t v = co_await lazy_fib(12);
+		std::cout << "lazy_fib(12)=" << v << std::endl;
+		assert(v == 144);
+
+		co_await lazy_ref() = 5;
+		assert(g_lazy_value == 5);
+
+		try
+		{
+			co_await lazy_throw();
+			assert(false);
+		}
+		catch (const std::logic_error& e)
+		{
+			std::cout << "caught " << e.what() << std::endl;
+		}
+
+		std::string s = co_await lazy_sleep_and_yield("lazy");
+		std::cout << s << std::endl;
+		assert(s == "lazy!");
+
+		//没有被co_await的lazy_t<>，不会开始运行
+		{
+			auto t = lazy_not_awaited(&started);
+			co_await yield();
+		}
+		assert(!started);
+	};
+	this_scheduler()->run_until_notask();
+}
+
+#if LIBRF_TUTORIAL_STAND_ALONE
+int main()
+{
+	resumable_main_lazy();
+	return 0;
+}
+#endif
@@ -73,6 +73,46 @@ void test_use_multi_thread()
 		th.join();
 }
 
+static future_t<int64_t> confined_square(int64_t val)
+{
+	co_await yield();
+	co_return val * val;
+}
+
+static future_t<> confined_sum(int64_t* sum, int64_t val)
+{
+	for (int64_t i = 0; i < 100; ++i)
+		*sum += co_await confined_square(val + i);
+}
+
+//每个线程一个互不共享state的调度器，声明为线程独占后，state的引用计数不再使用原子操作
+void test_use_confined_shards()
+{
+	int64_t sums[N + 1] = {};
+	auto run_shard = [&sums](size_t idx)
+	{
+		local_scheduler_t my_scheduler;
+		this_scheduler()->set_thread_confined(true);
+
+		for (int64_t k = 0; k < 100; ++k)
+			go confined_sum(&sums[idx], k);
+		this_scheduler()->run_until_notask();
+
+		this_scheduler()->set_thread_confined(false);
+	};
+
+	std::thread th_array[N];
+	for (size_t i = 0; i < N; ++i)
+		th_array[i] = std::thread(run_shard, i);
+	run_shard(N);
+	for (auto& th : th_array)
+		th.join();
+
+	for (int64_t sum : sums)
+		assert(sum == sums[0]);
+	std::cout << "confined shards: " << sums[0] << std::endl;
+}
+
 void resumable_main_multi_thread()
 {
 	std::cout << "test_use_single_thread @" << std::this_thread::get_id() << std::endl << std::endl;
@@ -82,6 +122,9 @@ void resumable_main_multi_thread()
 	std::cout << "test_use_multi_thread @" << std::this_thread::get_id() << std::endl << std::endl;
 	test_use_multi_thread();
 
+	std::cout << std::endl;
+	test_use_confined_shards();
+
 	//运行主调度器里面的协程
 	//但本范例不应该有协程存在，仅演示不要忽略了主调度器
 	scheduler_t::g_scheduler.run_until_notask();
@@ -0,0 +1,84 @@
+﻿#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "librf/librf.h"
+
+using namespace librf;
+
+static intptr_t g_low_steps = 0;
+static intptr_t g_low_steps_when_high_done = -1;
+static bool g_high_stop = false;
+
+static future_t<> priority_child(size_t n)
+{
+	//子协程继承了根协程的优先级
+	for (size_t i = 0; i < n; ++i)
+		co_await yield();
+}
+
+static future_t<> priority_high_task()
+{
+	for (size_t i = 0; i < 10; ++i)
+		co_await priority_child(2);
+	g_low_steps_when_high_done = g_low_steps;
+}
+
+static future_t<> priority_low_task()
+{
+	for (size_t i = 0; i < 10; ++i)
+	{
+		++g_low_steps;
+		co_await yield();
+	}
+}
+
+//高优先级的协程一直在运行，低优先级的协程也不会被饿死
+static future_t<> priority_busy_task()
+{
+	while (!g_high_stop)
+		co_await yield();
+}
+
+static future_t<> priority_low_then_stop_task()
+{
+	for (size_t i = 0; i < 10; ++i)
+		co_await yield();
+	g_high_stop = true;
+}
+
+void resumable_main_priority()
+{
+	std::cout << __FUNCTION__ << std::endl;
+
+	const size_t N = 100;
+	scheduler_t* sch = this_scheduler();
+
+	g_low_steps = 0;
+	g_low_steps_when_high_done = -1;
+	for (size_t i = 0; i < N; ++i)
+		sch->spawn(priority_low_task(), priority::low);
+	sch->spawn(priority_high_task(), priority::high);
+	sch->run_until_notask();
+
+	std::cout << "low steps when high done=" << g_low_steps_when_high_done << "/" << N * 10 << std::endl;
+	assert(g_low_steps == N * 10);
+	assert(g_low_steps_when_high_done >= 0 && g_low_steps_when_high_done < static_cast<intptr_t>(N * 10) / 2);
+
+	g_high_stop = false;
+	sch->spawn(priority_busy_task(), priority::high);
+	sch->spawn(priority_low_then_stop_task(), priority::low);
+	sch->run_until_notask();
+
+	std::cout << "busy high priority task stopped by low priority task" << std::endl;
+	assert(g_high_stop);
+}
+
+#if LIBRF_TUTORIAL_STAND_ALONE
+int main()
+{
+	resumable_main_priority();
+	return 0;
+}
+#endif
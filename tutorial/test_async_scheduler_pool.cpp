@@ -0,0 +1,102 @@
+﻿#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <set>
+
+#include "librf/librf.h"
+
+using namespace librf;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+
+static std::mutex cout_mutex;
+static std::atomic<intptr_t> g_pool_done{ 0 };
+
+//协程帧里的volatile变量可能被优化掉，故计算放在普通函数里
+static void pool_compute()
+{
+	volatile int64_t v = 0;
+	for (int64_t k = 0; k < 10000; ++k)
+		v = v + k;
+}
+
+//模拟一段计算，期间多次让出，以便被空闲的工作线程窃取
+static future_t<> pool_compute_task(std::set<std::thread::id>* threads, std::mutex* lock)
+{
+	for (size_t i = 0; i < 20; ++i)
+	{
+		{
+			scoped_lock<std::mutex> __lock(*lock);
+			threads->insert(std::this_thread::get_id());
+		}
+
+		pool_compute();
+		co_await yield();
+	}
+	++g_pool_done;
+}
+
+//通过via()固定到某个工作线程后，始终在这个工作线程上运行
+static future_t<> pool_pinned_task(scheduler_t* sch)
+{
+	co_await via(sch);
+
+	std::thread::id tid = std::this_thread::get_id();
+	for (size_t i = 0; i < 100; ++i)
+	{
+		co_await yield();
+		assert(tid == std::this_thread::get_id());
+		if (tid != std::this_thread::get_id())
+		{
+			scoped_lock<std::mutex> __lock(cout_mutex);
+			std::cout << "pinned task was stolen!" << std::endl;
+		}
+	}
+	++g_pool_done;
+}
+
+void resumable_main_scheduler_pool()
+{
+	std::cout << __FUNCTION__ << std::endl;
+
+	const size_t N = 1000;
+	std::set<std::thread::id> threads;
+	std::mutex threads_lock;
+
+	g_pool_done = 0;
+	{
+		scheduler_pool_t pool{ 4 };
+
+		//故意全部放到第一个调度器上，由其他工作线程来窃取
+		scheduler_t* sch = pool.get_scheduler(0);
+		for (size_t i = 0; i < N; ++i)
+			*sch + pool_compute_task(&threads, &threads_lock);
+
+		pool + pool_pinned_task(pool.get_scheduler(1));
+		pool + pool_pinned_task(pool.get_scheduler(2));
+
+		pool.wait_until_notask();
+	}
+
+	std::cout << "done=" << g_pool_done << ", threads=" << threads.size() << std::endl;
+	assert(g_pool_done == N + 2);
+	//计算协程全部放在第一个调度器上，在多个线程上运行过，说明发生了窃取
+	assert(threads.size() > 1);
+}
+
+#else
+
+void resumable_main_scheduler_pool()
+{
+}
+
+#endif	//!RESUMEF_DISABLE_MULT_THREAD
+
+#if LIBRF_TUTORIAL_STAND_ALONE
+int main()
+{
+	resumable_main_scheduler_pool();
+	return 0;
+}
+#endif
@@ -0,0 +1,154 @@
+﻿#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <future>
+
+#include "librf/librf.h"
+
+using namespace librf;
+
+#if !RESUMEF_DISABLE_MULT_THREAD
+
+static std::atomic<intptr_t> g_run_done{ 0 };
+
+static future_t<> run_sleep_task(int64_t ms)
+{
+	co_await sleep_for(std::chrono::milliseconds(ms));
+	++g_run_done;
+}
+
+static future_t<> run_wait_event_task(event_t evt)
+{
+	co_await evt.wait();
+	++g_run_done;
+}
+
+//调度器在另外一个线程里run()，空闲时停靠，由本线程加入的协程、触发的事件唤醒
+static void test_run_wakeup()
+{
+	using namespace std::chrono;
+
+	std::promise<scheduler_t*> sch_promise;
+	std::thread th([&sch_promise]
+	{
+		local_scheduler_t my_scheduler;
+		sch_promise.set_value(this_scheduler());
+
+		this_scheduler()->run();
+	});
+	scheduler_t* sch = sch_promise.get_future().get();
+
+	g_run_done = 0;
+	event_t evt;
+
+	//在其他线程里加入协程
+	*sch + run_wait_event_task(evt);
+	*sch + run_sleep_task(100);
+
+	//在其他线程里触发事件
+	std::this_thread::sleep_for(50ms);
+	evt.signal();
+
+	while (g_run_done < 2)
+		std::this_thread::sleep_for(1ms);
+
+	sch->stop();
+	th.join();
+
+	std::cout << "run() wakeup: done=" << g_run_done << std::endl;
+	assert(g_run_done == 2);
+}
+
+//run_for()在指定的时长后返回，期间由定时器唤醒
+static void test_run_for()
+{
+	using namespace std::chrono;
+
+	g_run_done = 0;
+	go run_sleep_task(50);
+	go run_sleep_task(80);
+
+	auto start = steady_clock::now();
+	this_scheduler()->run_for(200ms);
+	auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+
+	std::cout << "run_for(200ms): done=" << g_run_done << ", elapsed=" << elapsed << "ms" << std::endl;
+	assert(g_run_done == 2);
+	assert(elapsed >= 200);
+}
+
+static future_t<> run_count_task()
+{
+	++g_run_done;
+	co_return;
+}
+
+//限制一次运行的数量/时长，剩余的留到下一次运行
+static void test_run_one_batch_budget()
+{
+	using namespace std::chrono;
+
+	g_run_done = 0;
+	for (size_t i = 0; i < 100; ++i)
+		go run_count_task();
+
+	this_scheduler()->run_one_batch(10);
+	std::cout << "run_one_batch(10): done=" << g_run_done << std::endl;
+	assert(g_run_done == 10);
+
+	this_scheduler()->run_one_batch(1s);
+	std::cout << "run_one_batch(1s): done=" << g_run_done << std::endl;
+	assert(g_run_done == 100);
+
+	this_scheduler()->run_until_notask();
+}
+
+//在批次开始时的定时器回调里触发事件，被唤醒的协程不能丢失
+static void test_wakeup_from_timer()
+{
+	using namespace std::chrono;
+
+	g_run_done = 0;
+	event_t evt;
+	go run_wait_event_task(evt);
+	this_scheduler()->timer()->add(10ms, [evt](bool canceld)
+		{
+			if (!canceld)
+				evt.signal();
+		});
+
+	auto start = steady_clock::now();
+	while (g_run_done == 0 && steady_clock::now() - start < 1s)
+		this_scheduler()->run_one_batch();
+
+	std::cout << "wakeup from timer: done=" << g_run_done << std::endl;
+	assert(g_run_done == 1);
+	this_scheduler()->run_until_notask();
+}
+
+void resumable_main_scheduler_run()
+{
+	std::cout << __FUNCTION__ << std::endl;
+
+	test_run_wakeup();
+	test_run_for();
+	test_run_one_batch_budget();
+	test_wakeup_from_timer();
+}
+
+#else
+
+void resumable_main_scheduler_run()
+{
+}
+
+#endif	//!RESUMEF_DISABLE_MULT_THREAD
+
+#if LIBRF_TUTORIAL_STAND_ALONE
+int main()
+{
+	resumable_main_scheduler_run();
+	return 0;
+}
+#endif
@@ -64,6 +64,36 @@ void test_wait_all_events_with_signal_by_sleep()
 	}
 }
 
+void test_ticker()
+{
+	using namespace std::chrono;
+
+	auto ticker = interval(20ms);
+	go[&]() -> future_t<>
+	{
+		auto start = steady_clock::now();
+		size_t total = 0;
+		for (int i = 0; i < 5; ++i)
+		{
+			size_t ticks = co_await ticker;
+			total += ticks;
+
+			//处理耗时超过一个周期，下一次co_await会报告错过的触发
+			if (i == 2)
+				std::this_thread::sleep_for(50ms);
+		}
+		std::cout << "ticker: ticks=" << total << ", elapsed="
+			<< duration_cast<milliseconds>(steady_clock::now() - start).count() << "ms" << std::endl;
+		assert(total > 5);
+
+		ticker.stop();
+		size_t ticks = co_await ticker;
+		assert(ticks == 0);
+		(void)ticks;
+	};
+	this_scheduler()->run_until_notask();
+}
+
 void resumable_main_sleep()
 {
 	go test_sleep_use_timer();
@@ -72,6 +102,9 @@ void resumable_main_sleep()
 
 	test_wait_all_events_with_signal_by_sleep();
 	std::cout << std::endl;
+
+	test_ticker();
+	std::cout << std::endl;
 }
 
 #if LIBRF_TUTORIAL_STAND_ALONE
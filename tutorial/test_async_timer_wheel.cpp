@@ -0,0 +1,313 @@
+﻿#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <set>
+#include <vector>
+
+#include "librf/librf.h"
+
+using namespace librf;
+
+static intptr_t g_wheel_done = 0;
+static intptr_t g_wheel_early = 0;
+static std::chrono::milliseconds g_wheel_max_late{ 0 };
+
+static future_t<> wheel_sleep_task(std::chrono::milliseconds dt)
+{
+	using namespace std::chrono;
+
+	auto tp = steady_clock::now() + dt;
+	co_await sleep_until(tp);
+
+	auto now = steady_clock::now();
+	if (now < tp)
+		++g_wheel_early;
+	else
+		g_wheel_max_late = (std::max)(g_wheel_max_late, duration_cast<milliseconds>(now - tp));
+	++g_wheel_done;
+}
+
+//大量定时器放到时间轮里，超过第0层范围的定时器，经过级联后触发
+static void test_wheel_sleep()
+{
+	using namespace std::chrono;
+
+	const intptr_t N = 1000;
+	g_wheel_done = 0;
+	g_wheel_early = 0;
+	g_wheel_max_late = 0ms;
+
+	srand((int)time(nullptr));
+	for (intptr_t i = 0; i < N; ++i)
+		go wheel_sleep_task(1ms * (rand() % 600));
+
+	this_scheduler()->run_until_notask();
+
+	std::cout << "wheel sleep: done=" << g_wheel_done << ", early=" << g_wheel_early
+		<< ", max late=" << g_wheel_max_late.count() << "ms" << std::endl;
+	assert(g_wheel_done == N);
+	assert(g_wheel_early == 0);
+}
+
+//切换后端时，已经添加的定时器迁移到新的后端里
+static void test_wheel_switch_backend()
+{
+	using namespace std::chrono;
+
+	timer_manager* mgr = this_scheduler()->timer();
+
+	intptr_t fired = 0, canceled = 0;
+	auto th1 = mgr->add_handler(50ms, [&](bool bValue) { bValue ? ++canceled : ++fired; });
+	auto th2 = mgr->add_handler(100ms, [&](bool bValue) { bValue ? ++canceled : ++fired; });
+	mgr->update();
+
+	mgr->set_backend(timer_backend::rbtree);
+	th2.stop();
+	mgr->set_backend(timer_backend::wheel);
+
+	this_scheduler()->run_until_notask();
+
+	std::cout << "wheel switch backend: fired=" << fired << ", canceled=" << canceled << std::endl;
+	assert(fired == 1 && canceled == 1);
+}
+
+//默认的红黑树后端(侵入式的配对堆)：按到期时间的先后触发，到期时间相同的按添加的先后触发
+static void test_heap_order()
+{
+	using namespace std::chrono;
+
+	timer_manager* mgr = this_scheduler()->timer();
+
+	const intptr_t N = 1000;
+	std::unique_ptr<timer_manager::timer_node[]> nodes{ new timer_manager::timer_node[N] };
+	std::vector<intptr_t> order;
+	intptr_t canceled = 0;
+
+	auto base = mgr->now() + 10ms;
+	for (intptr_t i = 0; i < N; ++i)
+	{
+		nodes[i].tp = base + 1ms * (rand() % 50);
+		nodes[i].cb = [i, &order, &canceled](bool bValue)
+			{
+				if (bValue)
+					++canceled;
+				else
+					order.push_back(i);
+			};
+		mgr->add(&nodes[i]);
+	}
+	mgr->update();
+
+	//从堆的中间取消一部分定时器
+	intptr_t stopped = 0;
+	for (intptr_t i = 0; i < N; i += 3)
+	{
+		if (mgr->stop(&nodes[i]))
+			++stopped;
+	}
+
+	this_scheduler()->run_until_notask();
+
+	std::cout << "heap order: fired=" << order.size() << ", canceled=" << canceled << std::endl;
+	assert(canceled == stopped);
+	assert(static_cast<intptr_t>(order.size()) + canceled == N);
+	for (size_t k = 1; k < order.size(); ++k)
+	{
+		const auto& prev = nodes[order[k - 1]];
+		const auto& curr = nodes[order[k]];
+		assert(prev.tp < curr.tp || (prev.tp == curr.tp && order[k - 1] < order[k]));
+	}
+}
+
+//侵入式的定时器节点，由调用者拥有，添加和取消都不分配内存
+static void test_timer_node()
+{
+	using namespace std::chrono;
+
+	timer_manager* mgr = this_scheduler()->timer();
+
+	intptr_t fired = 0, canceled = 0;
+	timer_manager::timer_node nodes[2];
+	nodes[0].tp = mgr->now() + 20ms;
+	nodes[1].tp = mgr->now() + 30s;
+	for (auto& node : nodes)
+	{
+		node.cb = [&fired, &canceled](bool bValue) { bValue ? ++canceled : ++fired; };
+		mgr->add(&node);
+	}
+	mgr->update();
+
+	//被取消的定时器，在下一次update()时就被移除，不必等到30秒后
+	bool stopped = mgr->stop(&nodes[1]);
+	mgr->update();
+	assert(canceled == 1);
+
+	this_scheduler()->run_until_notask();
+
+	std::cout << "timer node: fired=" << fired << ", canceled=" << canceled << std::endl;
+	assert(stopped);
+	assert(fired == 1 && canceled == 1);
+	assert(!nodes[0].is_pending() && !nodes[1].is_pending());
+
+	//还在待添加链表里就被取消的节点，直到update()将其移出链表之前，仍然是pending的，不能重新添加
+	nodes[0].tp = mgr->now() + 30s;
+	nodes[0].cb = [&fired, &canceled](bool bValue) { bValue ? ++canceled : ++fired; };
+	mgr->add(&nodes[0]);
+	stopped = mgr->stop(&nodes[0]);
+	assert(stopped && nodes[0].is_pending());
+	assert(!mgr->stop(&nodes[0]));
+
+	mgr->update();
+	assert(canceled == 2 && !nodes[0].is_pending());
+}
+
+//设置slack后，到期时间相近的定时器，在同一个批次里触发
+static void test_timer_slack()
+{
+	using namespace std::chrono;
+
+	timer_manager* mgr = this_scheduler()->timer();
+	mgr->set_slack(100ms);
+
+	//定时器在批次开始时的update()里触发，按批次的序号区分
+	std::set<size_t> batches;
+	size_t batch = 0;
+	size_t fired = 0;
+	for (int i = 1; i <= 10; ++i)
+	{
+		mgr->add(milliseconds(i * 3), [&](bool canceld)
+			{
+				if (!canceld)
+				{
+					batches.insert(batch);
+					++fired;
+				}
+			});
+	}
+	while (fired < 10)
+	{
+		++batch;
+		this_scheduler()->run_one_batch();
+	}
+
+	mgr->set_slack(0ms);
+
+	std::cout << "timer slack: fired=" << fired << ", batches=" << batches.size() << std::endl;
+	assert(fired == 10);
+	assert(batches.size() <= 2);			//10个定时器最多跨越一个100ms窗口的边界
+}
+
+//批次里的now()是批次开始时读取的时间，相对定时器从批次开始算起；批次之外，now()重新读取时钟
+static void test_timer_clock()
+{
+	using namespace std::chrono;
+
+	timer_manager* mgr = this_scheduler()->timer();
+	mgr->set_clock_source(timer_clock_source::coarse);
+
+	bool cached = false;
+	steady_clock::duration elapsed{};
+	go[&]() -> future_t<>
+	{
+		auto batch_tp = mgr->now();
+		std::this_thread::sleep_for(2ms);
+		cached = mgr->now() == batch_tp;
+
+		//粗粒度的时钟落后于steady_clock，从批次开始算起，不会提前触发
+		co_await 20ms;
+		elapsed = steady_clock::now() - batch_tp;
+	};
+	this_scheduler()->run_until_notask();
+
+	auto tp1 = mgr->now();
+	std::this_thread::sleep_for(2ms);
+	bool fresh = mgr->now() - tp1 >= 2ms;
+
+	mgr->set_clock_source(timer_clock_source::steady);
+
+	std::cout << "timer clock: cached=" << cached << ", fresh=" << fresh << ", sleep 20ms elapsed="
+		<< duration_cast<milliseconds>(elapsed).count() << "ms" << std::endl;
+	assert(cached && fresh);
+	assert(elapsed >= 20ms);
+}
+
+//同一个批次里添加的大量相对定时器，共用批次开始时读取的时间，不会每添加一个就读取一次时钟
+static void test_timer_batch_now()
+{
+	using namespace std::chrono;
+
+	timer_manager* mgr = this_scheduler()->timer();
+
+	const intptr_t N = 1000;
+	intptr_t woken = 0;
+	bool same_tp = true;
+
+	//这些协程都在下一个批次里开始运行
+	for (intptr_t i = 0; i < N; ++i)
+	{
+		go[&woken]() -> future_t<>
+		{
+			co_await sleep_for(10ms);
+			++woken;
+		};
+	}
+	go[&]() -> future_t<>
+	{
+		auto tp = mgr->now() + 10ms;
+		for (intptr_t i = 0; i < N; ++i)
+		{
+			auto target = mgr->add(10ms, [](bool) {});
+			same_tp = same_tp && target->tp == tp;
+		}
+		co_return;
+	};
+
+#if RESUMEF_DEBUG_COUNTER
+	intptr_t clock_reads = g_resumef_timer_clock_count.load();
+#endif
+	this_scheduler()->run_one_batch();
+#if RESUMEF_DEBUG_COUNTER
+	clock_reads = g_resumef_timer_clock_count.load() - clock_reads;
+#endif
+	this_scheduler()->run_until_notask();
+
+	std::cout << "timer batch now: woken=" << woken << ", same tp=" << same_tp
+#if RESUMEF_DEBUG_COUNTER
+		<< ", clock reads=" << clock_reads
+#endif
+		<< std::endl;
+	assert(woken == N);
+	assert(same_tp);
+#if RESUMEF_DEBUG_COUNTER
+	assert(clock_reads == 1);			//只有批次开始时的update()读取了时钟
+#endif
+}
+
+void resumable_main_timer_wheel()
+{
+	std::cout << __FUNCTION__ << std::endl;
+
+	timer_manager* mgr = this_scheduler()->timer();
+	assert(mgr->get_backend() == timer_backend::rbtree);
+
+	test_heap_order();
+	test_timer_node();
+
+	mgr->set_backend(timer_backend::wheel);
+
+	test_wheel_sleep();
+	test_wheel_switch_backend();
+	test_timer_node();
+	test_timer_clock();
+	test_timer_batch_now();
+	test_timer_slack();
+}
+
+#if LIBRF_TUTORIAL_STAND_ALONE
+int main()
+{
+	resumable_main_timer_wheel();
+	return 0;
+}
+#endif